@@ -0,0 +1,7 @@
+MOVC R1,#0
+MOVC R5,#3
+ADDL R2,R1,#0
+BZ #8
+MOVC R3,#1
+MOVC R4,#2
+HALT
@@ -0,0 +1,15 @@
+MOVC R0,#0
+MOVC R1,#0
+MOVC R2,#0
+MOVC R9,#300
+MUL R3,R0,R0
+MUL R3,R3,R3
+STORE R2,R3,#10
+LOAD R4,R1,#10
+ADD R5,R5,R4
+LOAD R6,R1,#20
+ADD R7,R7,R6
+ADDL R2,R2,#1
+SUBL R9,R9,#1
+BNZ #-36
+HALT
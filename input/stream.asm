@@ -0,0 +1,8 @@
+MOVC R1,#0
+MOVC R9,#400
+LOAD R5,R1,#0
+ADD R6,R6,R5
+ADDL R1,R1,#8
+SUBL R9,R9,#1
+BNZ #-16
+HALT
@@ -0,0 +1,17 @@
+MOVC R9,#3
+MOVC R0,#0
+MOVC R2,#500
+LOAD R5,R0,#0
+STORE R5,R0,#3
+ADDL R0,R0,#7
+SUBL R2,R2,#1
+BNZ #-16
+MOVC R0,#40
+MOVC R2,#200
+LOAD R5,R0,#0
+ADDL R0,R0,#1
+SUBL R2,R2,#1
+BNZ #-12
+SUBL R9,R9,#1
+BNZ #-56
+HALT
@@ -0,0 +1,211 @@
+#include <stdio.h>
+
+#include "analysis.h"
+#include "cpu_settings.h"
+#include "rename.h"
+
+_Static_assert(ARCH_REGS_COUNT <= 32, "Register masks are 32 bits wide.");
+
+bool writes_cc(int op) {
+    switch (op) {
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_AND:
+    case OP_OR:
+    case OP_XOR:
+    case OP_ADDL:
+    case OP_SUBL:
+        return true;
+    }
+
+    return false;
+}
+
+bool needs_bis_entry(int op) {
+    switch (op) {
+    case OP_BZ:
+    case OP_BNZ:
+    case OP_BP:
+    case OP_BN:
+    case OP_BNP:
+    case OP_JUMP:
+    case OP_JALP:
+    case OP_RET:
+    case OP_HALT:
+        return true;
+    }
+
+    return false;
+}
+
+int station_of(int op) {
+    switch (op) {
+    case OP_LOAD:
+    case OP_STORE:
+    case OP_LDR:
+    case OP_STR:
+        return STATION_LSQ;
+    case OP_DIV:
+    case OP_MUL:
+        return STATION_MRS;
+    }
+
+    return STATION_IRS;
+}
+
+static bool is_conditional_branch(int op) {
+    return op == OP_BZ || op == OP_BNZ || op == OP_BP || op == OP_BN || op == OP_BNP;
+}
+
+// Index `imm` bytes away from instruction i, -1 if outside the program
+static int relative_target(const InstructionList *code, size_t i, int imm) {
+    if (imm % 4 != 0)
+        return -1;
+
+    long target = (long)i + imm / 4;
+    return target >= 0 && target < (long)code->len ? (int)target : -1;
+}
+
+void analyze_program(InstructionList *code, Arena *arena) {
+    StaticInfo *info = arena_alloc(arena, code->len * sizeof(StaticInfo) + 1);
+
+    for (size_t i = 0; i < code->len; i++) {
+        const Instruction *inst = &code->data[i];
+        StaticInfo *s = &info[i];
+        const int srcs[3] = { inst->rs1, inst->rs2, inst->rs3 };
+
+        for (int k = 0; k < 3; k++) {
+            if (srcs[k] != -1) {
+                s->src_mask |= 1u << srcs[k];
+                s->num_sources += 1;
+            }
+        }
+        if (inst->rd != -1)
+            s->dest_mask = 1u << inst->rd;
+
+        s->station = station_of(inst->op);
+        s->idiom = rename_idiom(inst);
+        s->writes_cc = writes_cc(inst->op);
+        s->reads_cc = is_conditional_branch(inst->op);
+        s->needs_bis = needs_bis_entry(inst->op);
+
+        // JUMP and RET targets come from registers
+        s->target = -1;
+        if (is_conditional_branch(inst->op) || inst->op == OP_JALP)
+            s->target = relative_target(code, i, inst->imm);
+    }
+
+    // Blocks start at the entry, after a control instruction and at the
+    // pc-relative targets
+    if (code->len > 0)
+        info[0].leader = true;
+
+    for (size_t i = 0; i < code->len; i++) {
+        if (!info[i].needs_bis)
+            continue;
+
+        if (i + 1 < code->len)
+            info[i + 1].leader = true;
+        if (info[i].target != -1)
+            info[info[i].target].leader = true;
+    }
+
+    // Producers are only followed inside a block, where the order is known
+    int last_writer[ARCH_REGS_COUNT];
+    int last_cc_writer = -1;
+    int block = -1;
+
+    for (size_t i = 0; i < code->len; i++) {
+        Instruction *inst = &code->data[i];
+        StaticInfo *s = &info[i];
+        const int srcs[3] = { inst->rs1, inst->rs2, inst->rs3 };
+
+        if (s->leader) {
+            block += 1;
+            for (int r = 0; r < ARCH_REGS_COUNT; r++) last_writer[r] = -1;
+            last_cc_writer = -1;
+        }
+        s->block = block;
+
+        for (int k = 0; k < 3; k++) {
+            s->producer[k] = srcs[k] != -1 ? last_writer[srcs[k]] : -1;
+        }
+        s->cc_producer = s->reads_cc ? last_cc_writer : -1;
+
+        if (inst->rd != -1)
+            last_writer[inst->rd] = i;
+        if (s->writes_cc)
+            last_cc_writer = i;
+
+        inst->info = s;
+    }
+}
+
+static const char *station_names[] = { "IRS", "LSQ", "MRS" };
+static const char *idiom_names[] = { "-", "movc", "zero", "move" };
+
+static void print_mask(uint32_t mask, FILE *out) {
+    int printed = 0;
+
+    for (int r = 0; r < ARCH_REGS_COUNT; r++) {
+        if (mask & 1u << r)
+            printed += fprintf(out, "%sR%d", printed ? "," : "", r);
+    }
+    fprintf(out, "%*s", printed < 10 ? 10 - printed : 0, "");
+}
+
+void print_analysis(const InstructionList *code, FILE *out) {
+    fprintf(out, "%5s %5s %5s %-5s %-10s %-10s %-2s %-3s %-5s %-6s %s\n",
+            "index", "pc", "block", "op", "sources", "dest", "cc", "rs", "idiom", "target", "producers");
+
+    int blocks = 0;
+    long sources = 0, in_block = 0;
+
+    for (size_t i = 0; i < code->len; i++) {
+        const Instruction *inst = &code->data[i];
+        const StaticInfo *s = inst->info;
+
+        blocks += s->leader;
+
+        fprintf(out, "%5zu %5zu %c%4d %-5s ", i, 4000 + 4 * i, s->leader ? '*' : ' ', s->block, get_op_name(inst->op));
+        print_mask(s->src_mask, out);
+        fputc(' ', out);
+        print_mask(s->dest_mask, out);
+        fprintf(out, " %c%c %-3s %-5s ", s->reads_cc ? 'r' : '-', s->writes_cc ? 'w' : '-',
+                station_names[s->station], idiom_names[s->idiom]);
+
+        if (s->target != -1) {
+            fprintf(out, "%-6d", s->target);
+        } else {
+            fprintf(out, "%-6s", "-");
+        }
+
+        const int srcs[3] = { inst->rs1, inst->rs2, inst->rs3 };
+        for (int k = 0; k < 3; k++) {
+            if (srcs[k] == -1)
+                continue;
+
+            sources += 1;
+            if (s->producer[k] != -1) {
+                in_block += 1;
+                fprintf(out, " R%d<%d", srcs[k], s->producer[k]);
+            } else {
+                fprintf(out, " R%d<in", srcs[k]);
+            }
+        }
+        if (s->reads_cc) {
+            if (s->cc_producer != -1) {
+                fprintf(out, " cc<%d", s->cc_producer);
+            } else {
+                fprintf(out, " cc<in");
+            }
+        }
+        fputc('\n', out);
+    }
+
+    fprintf(out, "Analysis: instructions=%zu blocks=%d avg_block=%.2f sources=%ld produced_in_block=%.1f%%\n",
+            code->len, blocks, blocks ? (double)code->len / blocks : 0.0, sources,
+            sources ? 100.0 * in_block / sources : 0.0);
+}
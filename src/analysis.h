@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "instruction.h"
+
+// Reservation station an instruction is dispatched to
+#define STATION_IRS 0
+#define STATION_LSQ 1
+#define STATION_MRS 2
+
+// What every dynamic instance of a static instruction would otherwise
+// work out again at rename and dispatch. Indexes are into the thread's
+// InstructionList.
+struct StaticInfo {
+    uint32_t src_mask;      // Architectural registers read, bit per register
+    uint32_t dest_mask;     // ... written
+    int8_t num_sources;
+    int8_t station;         // STATION_*
+    int8_t idiom;           // rename_idiom() of the instruction
+    bool writes_cc;
+    bool reads_cc;          // Conditional branches
+    bool needs_bis;         // Control instruction that takes a branch snapshot
+
+    bool leader;            // First instruction of a basic block
+    int block;              // Basic block, numbered in program order
+    int target;             // Pc-relative target, -1 if none or only known at run time
+    int producer[3];        // Instruction of the same block writing rs1..rs3, -1 if written before it
+    int cc_producer;        // ... writing the cc a branch reads, -1 if written before it
+};
+
+// Instructions that write a new value of the cc register
+bool writes_cc(int op);
+
+// Instructions that may call `reset_cpu_from_bis` and need a snapshot
+bool needs_bis_entry(int op);
+
+// STATION_* an opcode is dispatched to
+int station_of(int op);
+
+// Analyzes `code` at load time, every instruction's `info` points into an
+// array allocated from `arena`
+void analyze_program(InstructionList *code, Arena *arena);
+
+// One line per instruction and a summary of the blocks
+void print_analysis(const InstructionList *code, FILE *out);
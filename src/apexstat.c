@@ -0,0 +1,67 @@
+// Watches a running simulator through the stats block it publishes with
+// `--live <name>` (or APEX_LIVE=<name> in the REPL).
+//
+//      make apexstat
+//      ./apexstat [--interval <ms>] [--count <n>] <name>
+//
+// Prints one line per interval until the simulation ends or `count` lines
+// were printed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "livestats.h"
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+int main(int argc, char **argv) {
+    int interval_ms = 1000;
+    int count = -1;
+    int i = 1;
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else {
+            break;
+        }
+    }
+
+    if (i + 1 != argc || interval_ms < 1) {
+        printf("Usage: ./apexstat [--interval <ms>] [--count <n>] <name>\n");
+        return 1;
+    }
+
+    const LiveStats *block = live_attach(argv[i]);
+    if (block == NULL) {
+        printf("No simulator publishes `%s` (or it is of another version).\n", argv[i]);
+        return 1;
+    }
+
+    LiveStats s;
+    live_read(block, &s);
+    printf("pid %d\n%12s %12s %7s %7s %4s %4s %4s %4s %12s\n", s.pid,
+           "cycle", "committed", "IPC", "recent", "IRS", "MRS", "LSQ", "ROB", "cycles/s");
+
+    for (int n = 0; n != count; n++) {
+        live_read(block, &s);
+        printf("%12ld %12ld %7.3f %7.3f %4d %4d %4d %4d %12.0f\n", (long)s.cycle, (long)s.committed,
+               s.ipc, s.recent_ipc, s.irs, s.mrs, s.lsq, s.rob, s.host_cycles_per_sec);
+        fflush(stdout);
+
+        if (s.done) {
+            printf("Simulation ended.\n");
+            break;
+        }
+        sleep_ms(interval_ms);
+    }
+
+    return 0;
+}
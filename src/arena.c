@@ -0,0 +1,125 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+// Station tag rows in a Cpu are 32-byte aligned for the vector kernels
+#define ARENA_ALIGN 32
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t cap;
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// Per host thread, so multi-core runs can check each core on its own
+static _Thread_local size_t heap_call_count;
+
+void *heap_alloc(size_t size) {
+    heap_call_count += 1;
+
+    void *ptr = aligned_alloc(ARENA_ALIGN, align_up(size));
+    if (ptr == NULL) {
+        printf("Failed to allocate %zu bytes\n", size);
+        exit(1);
+    }
+
+    return ptr;
+}
+
+void heap_free(void *ptr) {
+    if (ptr == NULL) return;
+
+    heap_call_count += 1;
+    free(ptr);
+}
+
+size_t heap_calls(void) {
+    return heap_call_count;
+}
+
+static ArenaBlock *new_block(size_t cap) {
+    ArenaBlock *block = heap_alloc(sizeof(ArenaBlock) + cap);
+    block->next = NULL;
+    block->cap = cap;
+    block->used = 0;
+
+    return block;
+}
+
+Arena arena_new(size_t block_size) {
+    return (Arena){ .head = NULL, .block_size = block_size, .fixed = false };
+}
+
+Arena arena_fixed(size_t capacity) {
+    Arena arena = { .head = new_block(align_up(capacity)), .block_size = 0, .fixed = true };
+
+    return arena;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = align_up(size);
+
+    ArenaBlock *block = arena->head;
+    if (block == NULL || block->cap - block->used < size) {
+        if (arena->fixed) {
+            printf("Fixed arena exhausted, %zu more bytes needed\n", size);
+            exit(1);
+        }
+
+        block = new_block(size > arena->block_size ? size : arena->block_size);
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    memset(ptr, 0, size);
+
+    return ptr;
+}
+
+void *arena_grow(Arena *arena, void *old, size_t old_size, size_t new_size) {
+    ArenaBlock *block = arena->head;
+
+    // The last allocation can be extended while its block has room
+    if (old != NULL && block != NULL
+        && (unsigned char *)old + align_up(old_size) == block->data + block->used
+        && block->used - align_up(old_size) + align_up(new_size) <= block->cap) {
+        block->used += align_up(new_size) - align_up(old_size);
+        return old;
+    }
+
+    void *ptr = arena_alloc(arena, new_size);
+    if (old != NULL) {
+        memcpy(ptr, old, old_size < new_size ? old_size : new_size);
+    }
+
+    return ptr;
+}
+
+char *arena_strdup(Arena *arena, const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = arena_alloc(arena, len);
+    memcpy(copy, str, len);
+
+    return copy;
+}
+
+void arena_release(Arena *arena) {
+    ArenaBlock *block = arena->head;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        heap_free(block);
+        block = next;
+    }
+
+    arena->head = NULL;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bump allocator, everything allocated from it is released at once.
+//
+// The parser allocates from a scratch arena released at the end of
+// `parse()`. A Cpu and a MultiCore own an arena for what lives as long as
+// the simulation, so stepping the simulation never touches the heap.
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;   // Block allocations are made from, newest first
+    size_t block_size;  // Minimum size of a new block
+    bool fixed;         // A fixed arena never grows past its first block
+} Arena;
+
+// Arena that adds blocks of at least `block_size` bytes as needed
+Arena arena_new(size_t block_size);
+
+// Pool of exactly `capacity` bytes, running out of it is fatal
+Arena arena_fixed(size_t capacity);
+
+// Zeroed memory aligned for any type
+void *arena_alloc(Arena *arena, size_t size);
+
+// Resizes the last allocation in place when possible, otherwise copies it
+void *arena_grow(Arena *arena, void *old, size_t old_size, size_t new_size);
+
+char *arena_strdup(Arena *arena, const char *str);
+
+// Frees every block, a growable arena can be reused afterwards
+void arena_release(Arena *arena);
+
+// Every heap call of the simulator goes through these so they can be counted
+void *heap_alloc(size_t size);
+void heap_free(void *ptr);
+
+// Heap calls made so far by the calling host thread
+size_t heap_calls(void);
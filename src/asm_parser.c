@@ -1,6 +1,13 @@
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "instruction.h"
 #include "cpu_settings.h"
 
@@ -28,13 +35,31 @@ typedef struct
     size_t len, cap;
 } InstructionTokenList;
 
+// Set while a worker parses a chunk: errors unwind to it silently, the
+// chunk is parsed again serially to report the first one like parse() would
+static _Thread_local jmp_buf *bailout;
+
+__attribute__((noreturn, format(printf, 2, 3)))
+static void parse_error(FILE *stream, const char *fmt, ...)
+{
+    if (bailout != NULL)
+    {
+        longjmp(*bailout, 1);
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stream, fmt, args);
+    va_end(args);
+    exit(1);
+}
+
 void read_di(Instruction *inst, InstructionToken *it)
 {
     char *reg, *imm;
     if (it->num_regs != 2)
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` requires one destination register and one immediate value.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` requires one destination register and one immediate value.\n", it->line, it->op);
     }
 
     reg = it->regs[0];
@@ -44,8 +69,7 @@ void read_di(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
     }
 
     imm = it->regs[1];
@@ -55,8 +79,7 @@ void read_di(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` second value must be immediate value.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` second value must be immediate value.\n", it->line, it->op);
     }
 }
 
@@ -65,8 +88,7 @@ void read_si(Instruction *inst, InstructionToken *it)
     char *reg, *imm;
     if (it->num_regs != 2)
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` requires one source register and one immediate value.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` requires one source register and one immediate value.\n", it->line, it->op);
     }
 
     reg = it->regs[0];
@@ -76,8 +98,7 @@ void read_si(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
     }
 
     imm = it->regs[1];
@@ -87,8 +108,7 @@ void read_si(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` second value must be immediate value.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` second value must be immediate value.\n", it->line, it->op);
     }
 }
 
@@ -97,8 +117,7 @@ void read_dsi(Instruction *inst, InstructionToken *it)
     char *reg, *imm;
     if (it->num_regs != 3)
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` requires one destination register, one source register, and one immediate value.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` requires one destination register, one source register, and one immediate value.\n", it->line, it->op);
     }
 
     reg = it->regs[0];
@@ -108,8 +127,7 @@ void read_dsi(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
     }
 
     reg = it->regs[1];
@@ -119,8 +137,7 @@ void read_dsi(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` second value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` second value must be a register.\n", it->line, it->op);
     }
 
     imm = it->regs[2];
@@ -130,8 +147,7 @@ void read_dsi(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` third value must be immediate value.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` third value must be immediate value.\n", it->line, it->op);
     }
 }
 
@@ -141,8 +157,7 @@ void read_dss(Instruction *inst, InstructionToken *it)
 
     if (it->num_regs != 3)
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` requires one destination register and two source registers.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` requires one destination register and two source registers.\n", it->line, it->op);
     }
 
     reg = it->regs[0];
@@ -152,8 +167,7 @@ void read_dss(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
     }
 
     reg = it->regs[1];
@@ -163,8 +177,7 @@ void read_dss(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` second value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` second value must be a register.\n", it->line, it->op);
     }
 
     reg = it->regs[2];
@@ -174,8 +187,7 @@ void read_dss(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` third value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` third value must be a register.\n", it->line, it->op);
     }
 }
 
@@ -185,8 +197,7 @@ void read_sss(Instruction *inst, InstructionToken *it)
 
     if (it->num_regs != 3)
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` requires three source registers.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` requires three source registers.\n", it->line, it->op);
     }
 
     reg = it->regs[0];
@@ -196,8 +207,7 @@ void read_sss(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
     }
 
     reg = it->regs[1];
@@ -207,8 +217,7 @@ void read_sss(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` second value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` second value must be a register.\n", it->line, it->op);
     }
 
     reg = it->regs[2];
@@ -218,8 +227,7 @@ void read_sss(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` third value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` third value must be a register.\n", it->line, it->op);
     }
 }
 
@@ -229,8 +237,7 @@ void read_ssi(Instruction *inst, InstructionToken *it)
 
     if (it->num_regs != 3)
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` requires two source register and one immediate value.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` requires two source register and one immediate value.\n", it->line, it->op);
     }
 
     reg = it->regs[0];
@@ -240,8 +247,7 @@ void read_ssi(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
     }
 
     reg = it->regs[1];
@@ -251,8 +257,7 @@ void read_ssi(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` second value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` second value must be a register.\n", it->line, it->op);
     }
 
     imm = it->regs[2];
@@ -262,8 +267,7 @@ void read_ssi(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` third value must be immediate value.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` third value must be immediate value.\n", it->line, it->op);
     }
 }
 
@@ -273,8 +277,7 @@ void read_ss(Instruction *inst, InstructionToken *it)
 
     if (it->num_regs != 2)
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` requires two source registers.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` requires two source registers.\n", it->line, it->op);
     }
 
     reg = it->regs[0];
@@ -284,8 +287,7 @@ void read_ss(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
     }
 
     reg = it->regs[1];
@@ -295,8 +297,7 @@ void read_ss(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` second value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` second value must be a register.\n", it->line, it->op);
     }
 }
 
@@ -306,8 +307,7 @@ void read_s(Instruction *inst, InstructionToken *it)
 
     if (it->num_regs != 1)
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` requires one source register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` requires one source register.\n", it->line, it->op);
     }
 
     reg = it->regs[0];
@@ -317,8 +317,7 @@ void read_s(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` first value must be a register.\n", it->line, it->op);
     }
 }
 
@@ -328,8 +327,7 @@ void read_i(Instruction *inst, InstructionToken *it)
 
     if (it->num_regs != 1)
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` one immediate value.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` one immediate value.\n", it->line, it->op);
     }
 
     imm = it->regs[0];
@@ -339,8 +337,7 @@ void read_i(Instruction *inst, InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: `%s` first value must be immediate value.\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: `%s` first value must be immediate value.\n", it->line, it->op);
     }
 }
 
@@ -350,7 +347,6 @@ Instruction parse_instruction(InstructionToken *it)
         .pc = -1,
         .next_pc = -1,
 
-        .bis_entry = {0},
 
         .op = -1,
         .rd = -1,
@@ -359,6 +355,11 @@ Instruction parse_instruction(InstructionToken *it)
         .rs3 = -1,
         .imm = -1,
         .cc = -1,
+        .prev_rd = -1,
+        .prev_cc = -1,
+        .fused_op = -1,
+        .thread = 0,
+        .trace_index = -1,
     };
     
     if (strcmp(it->op, "ADD") == 0)
@@ -491,25 +492,20 @@ Instruction parse_instruction(InstructionToken *it)
     }
     else
     {
-        fprintf(stderr, "ERROR: Line %lu: Unknown opcode `%s`\n", it->line, it->op);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: Unknown opcode `%s`\n", it->line, it->op);
     }
 
     if (instruction.rs1 >= ARCH_REGS_COUNT) {
-        fprintf(stderr, "ERROR: Line %lu: Invalid register R%d\n", it->line, instruction.rs1);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: Invalid register R%d\n", it->line, instruction.rs1);
     }
     if (instruction.rs2 >= ARCH_REGS_COUNT) {
-        fprintf(stderr, "ERROR: Line %lu: Invalid register R%d\n", it->line, instruction.rs2);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: Invalid register R%d\n", it->line, instruction.rs2);
     }
     if (instruction.rs3 >= ARCH_REGS_COUNT) {
-        fprintf(stderr, "ERROR: Line %lu: Invalid register R%d\n", it->line, instruction.rs3);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: Invalid register R%d\n", it->line, instruction.rs3);
     }
     if (instruction.rd >= ARCH_REGS_COUNT) {
-        fprintf(stderr, "ERROR: Line %lu: Invalid register R%d\n", it->line, instruction.rd);
-        exit(1);
+        parse_error(stderr, "ERROR: Line %lu: Invalid register R%d\n", it->line, instruction.rd);
     }
 
     return instruction;
@@ -557,28 +553,6 @@ void print_token(Token t)
     printf("Token { %s }\n", t.value);
 }
 
-char *read_file(char *file_name)
-{
-    char *buffer = NULL;
-    long length;
-    FILE *f = fopen(file_name, "rb");
-
-    if (f)
-    {
-        fseek(f, 0, SEEK_END);
-        length = ftell(f);
-        fseek(f, 0, SEEK_SET);
-        buffer = malloc(length + 1);
-        if (buffer)
-        {
-            fread(buffer, 1, length, f);
-            buffer[length] = '\0';
-        }
-        fclose(f);
-    }
-    return buffer;
-}
-
 void print_instruction_token(InstructionToken inst)
 {
     printf("InstructionToken { %s ", inst.op);
@@ -589,62 +563,39 @@ void print_instruction_token(InstructionToken inst)
     printf("} on line: %lu\n", inst.line);
 }
 
-InstructionTokenList new_inst_tok_list()
+InstructionTokenList new_inst_tok_list(Arena *arena)
 {
     InstructionTokenList list;
     list.len = 0;
-    list.cap = 2;
-    list.data = malloc(list.cap * sizeof(InstructionToken));
-
-    if (list.data == NULL)
-    {
-        printf("Failed to allocate InstructionTokenList\n");
-        exit(1);
-    }
+    list.cap = 16;
+    list.data = arena_alloc(arena, list.cap * sizeof(InstructionToken));
 
     return list;
 }
 
-void add_instruction_token(InstructionTokenList *list, InstructionToken inst)
+void add_instruction_token(Arena *arena, InstructionTokenList *list, InstructionToken inst)
 {
     if (list->len == list->cap)
     {
+        list->data = arena_grow(arena, list->data, list->cap * sizeof(InstructionToken), 2 * list->cap * sizeof(InstructionToken));
         list->cap *= 2;
-        list->data = realloc(list->data, list->cap * sizeof(InstructionToken));
     }
 
     list->data[list->len] = inst;
     list->len += 1;
 }
 
-InstructionList new_inst_list()
+// The final list is sized once, the parser knows the instruction count
+InstructionList new_inst_list(Arena *arena, size_t cap)
 {
     InstructionList list;
     list.len = 0;
-    list.cap = 2;
-    list.data = malloc(list.cap * sizeof(Instruction));
-
-    if (list.data == NULL)
-    {
-        printf("Failed to allocate InstructionList\n");
-        exit(1);
-    }
+    list.cap = cap;
+    list.data = arena_alloc(arena, list.cap * sizeof(Instruction));
 
     return list;
 }
 
-void add_instruction(InstructionList *list, Instruction inst)
-{
-    if (list->len == list->cap)
-    {
-        list->cap *= 2;
-        list->data = realloc(list->data, list->cap * sizeof(Instruction));
-    }
-
-    list->data[list->len] = inst;
-    list->len += 1;
-}
-
 int is_alpha(char c)
 {
     return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
@@ -660,12 +611,10 @@ int is_alpha_or_digit(char c)
     return is_alpha(c) || is_digit(c);
 }
 
-// Assumes that src is not NULL
-InstructionTokenList parse_assembly(char *src)
+// Tokenizes `len` bytes of src, instruction lines are numbered from first_line + 1
+InstructionTokenList parse_assembly(const char *src, size_t len, size_t first_line, Arena *arena)
 {
-    size_t len = strlen(src);
-
-    size_t line = 0;
+    size_t line = first_line;
 
     char acc[64];
     size_t acc_idx = 0;
@@ -674,11 +623,11 @@ InstructionTokenList parse_assembly(char *src)
     Token list[64];
     size_t list_idx = 0;
 
-    InstructionTokenList code = new_inst_tok_list();
+    InstructionTokenList code = new_inst_tok_list(arena);
 
     for (size_t i = 0; i <= len; i++)
     {
-        char c = src[i];
+        char c = i < len ? src[i] : '\0';
         if (is_alpha_or_digit(c) || c == '#' || c == '-')
         {
             // Store character into the token
@@ -688,8 +637,7 @@ InstructionTokenList parse_assembly(char *src)
             if (acc_idx > 62)
             {
                 acc[acc_idx] = '\0';
-                printf("Error: Really long token enountered `%s...` on line: %lu\n", acc, line);
-                exit(1);
+                parse_error(stdout, "Error: Really long token enountered `%s...` on line: %lu\n", acc, line);
             }
         }
         else if (c == '\n' || c == '\0' || c == '\t' || c == ' ' || c == '\r' || c == ',')
@@ -704,14 +652,7 @@ InstructionTokenList parse_assembly(char *src)
 
                 t.span.x = token_start;
                 t.span.y = line;
-                t.value = (char *)malloc(acc_idx);
-                if (t.value == NULL)
-                {
-                    printf("Error: Failed to allocate token while parsing input.\n");
-                    exit(1);
-                }
-
-                strcpy(t.value, acc);
+                t.value = arena_strdup(arena, acc);
 
                 list[list_idx] = t;
                 list_idx += 1;
@@ -724,7 +665,7 @@ InstructionTokenList parse_assembly(char *src)
 
                 inst.line = line + 1;
                 inst.op = list[0].value;
-                inst.regs = calloc(list_idx - 1, sizeof(char *));
+                inst.regs = arena_alloc(arena, (list_idx - 1) * sizeof(char *));
                 inst.num_regs = list_idx - 1;
 
                 for (size_t j = 1; j < list_idx; j++)
@@ -732,7 +673,7 @@ InstructionTokenList parse_assembly(char *src)
                     inst.regs[j - 1] = list[j].value;
                 }
 
-                add_instruction_token(&code, inst);
+                add_instruction_token(arena, &code, inst);
 
                 line += 1;
                 list_idx = 0;
@@ -743,33 +684,221 @@ InstructionTokenList parse_assembly(char *src)
         else
         {
             // Invalid character found
-            printf("Error: Invalid character `%c` found on line\n", c);
-            exit(1);
+            parse_error(stdout, "Error: Invalid character `%c` found on line\n", c);
         }
     }
 
     return code;
 }
 
-InstructionList parse(char *file_name)
+// A slice of the source ending after a newline (or at the end of the file).
+// Chunks hold whole lines, so they tokenize the same alone as in one pass.
+typedef struct
+{
+    const char *src;
+    size_t len;
+    Arena scratch;                  // Tokens of the chunk
+    InstructionTokenList tokens;
+    size_t first;                   // Index of the chunk's first instruction
+    InstructionList *list;
+    bool failed;
+} ParseChunk;
+
+static void *tokenize_chunk(void *arg)
 {
-    char *src = read_file(file_name);
-    if (src == NULL)
+    ParseChunk *chunk = arg;
+    jmp_buf env;
+
+    bailout = &env;
+    if (setjmp(env) == 0)
+    {
+        chunk->tokens = parse_assembly(chunk->src, chunk->len, 0, &chunk->scratch);
+    }
+    else
+    {
+        chunk->failed = true;
+    }
+    bailout = NULL;
+
+    return NULL;
+}
+
+static void decode_tokens(ParseChunk *chunk)
+{
+    for (size_t i = 0; i < chunk->tokens.len; i++)
+    {
+        InstructionToken it = chunk->tokens.data[i];
+        it.line += chunk->first;
+        chunk->list->data[chunk->first + i] = parse_instruction(&it);
+    }
+}
+
+static void *decode_chunk(void *arg)
+{
+    ParseChunk *chunk = arg;
+    jmp_buf env;
+
+    bailout = &env;
+    if (setjmp(env) == 0)
+    {
+        decode_tokens(chunk);
+    }
+    else
+    {
+        chunk->failed = true;
+    }
+    bailout = NULL;
+
+    return NULL;
+}
+
+// Runs `work` on every chunk, on a host thread each but the first
+static void run_chunks(ParseChunk *chunks, int num_chunks, void *(*work)(void *))
+{
+    pthread_t threads[PARSE_MAX_THREADS];
+    bool started[PARSE_MAX_THREADS] = { false };
+
+    for (int c = 1; c < num_chunks; c++)
+    {
+        started[c] = pthread_create(&threads[c], NULL, work, &chunks[c]) == 0;
+    }
+    work(&chunks[0]);
+
+    // A chunk whose thread could not be started runs here instead
+    for (int c = 1; c < num_chunks; c++)
+    {
+        if (started[c])
+        {
+            pthread_join(threads[c], NULL);
+        }
+        else
+        {
+            work(&chunks[c]);
+        }
+    }
+}
+
+// First chunk that failed, parsed again serially so its error is reported
+// with the line number the serial parser gives and the process exits
+static void report_failed_chunk(ParseChunk *chunks, int num_chunks, bool decoding)
+{
+    size_t first = 0;
+
+    for (int c = 0; c < num_chunks; c++)
+    {
+        ParseChunk *chunk = &chunks[c];
+        if (chunk->failed)
+        {
+            if (decoding)
+            {
+                decode_tokens(chunk);
+            }
+            else
+            {
+                parse_assembly(chunk->src, chunk->len, first, &chunk->scratch);
+            }
+        }
+        first += chunk->tokens.len;
+    }
+}
+
+static int parse_thread_count(size_t bytes, int threads)
+{
+    if (threads <= 0)
+    {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (bytes / PARSE_CHUNK_MIN_BYTES < (size_t)threads)
+        {
+            threads = bytes / PARSE_CHUNK_MIN_BYTES;
+        }
+    }
+
+    if (threads > PARSE_MAX_THREADS)
+    {
+        threads = PARSE_MAX_THREADS;
+    }
+
+    return threads < 1 ? 1 : threads;
+}
+
+InstructionList parse_threads(char *file_name, Arena *arena, int threads)
+{
+    int fd = open(file_name, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
     {
         printf("Failed to read from file.\n");
         exit(1);
     }
 
-    InstructionTokenList code = parse_assembly(src);
-    InstructionList list = new_inst_list();
+    size_t len = st.st_size;
+    const char *src = "";
+    if (len > 0)
+    {
+        src = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (src == MAP_FAILED)
+        {
+            printf("Failed to read from file.\n");
+            exit(1);
+        }
+    }
+    close(fd);
+
+    // Split into about equal chunks, each one ending after a newline
+    ParseChunk chunks[PARSE_MAX_THREADS];
+    int num_chunks = 0;
+    int wanted = parse_thread_count(len, threads);
+
+    for (size_t start = 0; start < len || num_chunks == 0; num_chunks++)
+    {
+        size_t end = num_chunks + 1 == wanted ? len : start + (len - start) / (wanted - num_chunks);
+        while (end < len && (end == 0 || src[end - 1] != '\n'))
+        {
+            end += 1;
+        }
+
+        // Source and tokens only live until the instructions are built
+        chunks[num_chunks] = (ParseChunk){
+            .src = src + start,
+            .len = end - start,
+            .scratch = arena_new(16 * 1024),
+        };
+        start = end;
+    }
+
+    run_chunks(chunks, num_chunks, tokenize_chunk);
+    report_failed_chunk(chunks, num_chunks, false);
+
+    size_t count = 0;
+    for (int c = 0; c < num_chunks; c++)
+    {
+        chunks[c].first = count;
+        count += chunks[c].tokens.len;
+    }
+
+    InstructionList list = new_inst_list(arena, count);
+    list.len = count;
+    for (int c = 0; c < num_chunks; c++)
+    {
+        chunks[c].list = &list;
+    }
+
+    run_chunks(chunks, num_chunks, decode_chunk);
+    report_failed_chunk(chunks, num_chunks, true);
 
-    for (size_t i = 0; i < code.len; i++)
+    for (int c = 0; c < num_chunks; c++)
     {
-        Instruction inst = parse_instruction(&code.data[i]);
-        add_instruction(&list, inst);
+        arena_release(&chunks[c].scratch);
+    }
+    if (len > 0)
+    {
+        munmap((void *)src, len);
     }
 
-    // TODO: Free InstructionTokenList
-    free(src);
     return list;
 }
+
+InstructionList parse(char *file_name, Arena *arena)
+{
+    return parse_threads(file_name, arena, 0);
+}
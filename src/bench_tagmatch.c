@@ -0,0 +1,129 @@
+// Benchmark of the tag broadcast and readiness kernels used by the
+// reservation stations, for station sizes well past IRS_CAPACITY.
+//
+//      make bench
+//
+// Every supported kernel is checked against the scalar one first. The
+// sizes of the station and ROB structures are reported at the end.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bis.h"
+#include "rs.h"
+#include "tagmatch.h"
+
+#define MAX_ENTRIES 4096
+#define WORK        (1 << 24)   // Entries compared per kernel and size
+#define CACHE_LINE  64
+
+static int32_t tags[TAG_ROWS][TAG_SLOTS(MAX_ENTRIES)] __attribute__((aligned(32)));
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Half of the sources are pending on one of 240 physical registers
+static void fill_tags(int len) {
+    srand(len);
+    for (int k = 0; k < TAG_ROWS; k++) {
+        for (int i = 0; i < TAG_SLOTS(len); i++) {
+            tags[k][i] = (rand() % 2) ? rand() % 240 : -1;
+        }
+    }
+}
+
+static int same_as_scalar(const TagKernel *kernel, int len) {
+    const TagKernel *scalar = tagmatch_kernel(0);
+    uint64_t want[TAG_MASK_WORDS(MAX_ENTRIES)];
+    uint64_t got[TAG_MASK_WORDS(MAX_ENTRIES)];
+
+    for (int tag = -1; tag < 240; tag++) {
+        scalar->match(tags[0], len, tag, want);
+        kernel->match(tags[0], len, tag, got);
+        if (memcmp(want, got, sizeof(uint64_t) * TAG_MASK_WORDS(len))) return 0;
+    }
+
+    scalar->ready(tags[0], TAG_SLOTS(MAX_ENTRIES), len, want);
+    kernel->ready(tags[0], TAG_SLOTS(MAX_ENTRIES), len, got);
+
+    return memcmp(want, got, sizeof(uint64_t) * TAG_MASK_WORDS(len)) == 0;
+}
+
+// Nanoseconds for one broadcast (the three source rows) plus one readiness scan
+static double time_kernel(const TagKernel *kernel, int len) {
+    uint64_t hits[TAG_MASK_WORDS(MAX_ENTRIES)];
+    uint64_t sink = 0;
+    int rounds = WORK / len;
+
+    double start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int k = 0; k < 3; k++) {
+            kernel->match(tags[k], len, r % 240, hits);
+            sink += hits[0];
+        }
+        kernel->ready(tags[0], TAG_SLOTS(MAX_ENTRIES), len, hits);
+        sink += hits[0];
+    }
+    double elapsed = now_ns() - start;
+
+    // Keeps the loop from being optimized out
+    if (sink == 42) printf(" ");
+
+    return elapsed / rounds;
+}
+
+static void print_size(const char *name, size_t bytes) {
+    printf("%-34s %6zu bytes %6.2f cache lines\n", name, bytes, (double)bytes / CACHE_LINE);
+}
+
+// Bytes touched per entry by a station scan versus the entry payload
+static void print_layout(void) {
+    size_t hot = TAG_ROWS * sizeof(int32_t);
+
+    printf("\nLayout (%d byte cache lines):\n", CACHE_LINE);
+    print_size("IQE payload (ROB slot)", sizeof(IQE));
+    print_size("BisEntry (ROB side table)", sizeof(BisEntry));
+    print_size("Station tags per entry (scanned)", hot);
+    print_size("IRS tags (scanned)", sizeof(((IRS *)0)->tags));
+    print_size("IRS total", sizeof(IRS));
+    printf("%-34s %6d entries per cache line\n", "Station tag row", (int)(CACHE_LINE / sizeof(int32_t)));
+}
+
+int main(void) {
+    int sizes[] = { 8, 16, 64, 256, 1024, 4096 };
+
+    printf("%8s %8s %14s %8s\n", "entries", "kernel", "ns/broadcast", "speedup");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int len = sizes[s];
+        fill_tags(len);
+
+        double scalar_ns = 0;
+        const TagKernel *kernel;
+        for (int i = 0; (kernel = tagmatch_kernel(i)) != NULL; i++) {
+            if (!tagmatch_supported(kernel)) {
+                printf("%8d %8s %14s\n", len, kernel->name, "unsupported");
+                continue;
+            }
+
+            if (!same_as_scalar(kernel, len)) {
+                printf("ERROR: %s kernel disagrees with scalar for %d entries\n", kernel->name, len);
+                return 1;
+            }
+
+            double ns = time_kernel(kernel, len);
+            if (i == 0) scalar_ns = ns;
+
+            printf("%8d %8s %14.1f %7.2fx\n", len, kernel->name, ns, scalar_ns / ns);
+        }
+    }
+
+    print_layout();
+
+    return 0;
+}
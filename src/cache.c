@@ -0,0 +1,78 @@
+#include <stdio.h>
+
+#include "cache.h"
+
+int cache_line_of(int address) {
+    return address / L1_LINE_WORDS;
+}
+
+static int set_of(int line) {
+    return line % L1_SETS;
+}
+
+CacheLine *cache_probe(Cache *cache, int address) {
+    int line = cache_line_of(address);
+    CacheLine *set = cache->lines[set_of(line)];
+
+    for (int i = 0; i < L1_WAYS; i++) {
+        if (set[i].state != MESI_I && set[i].tag == line) {
+            return &set[i];
+        }
+    }
+
+    return NULL;
+}
+
+CacheLine *cache_lookup(Cache *cache, int address) {
+    CacheLine *hit = cache_probe(cache, address);
+
+    if (hit == NULL) {
+        cache->misses += 1;
+        return NULL;
+    }
+
+    cache->hits += 1;
+    cache->stamp += 1;
+    hit->lru = cache->stamp;
+
+    return hit;
+}
+
+CacheLine *cache_allocate(Cache *cache, int address) {
+    int line = cache_line_of(address);
+    CacheLine *set = cache->lines[set_of(line)];
+    CacheLine *victim = &set[0];
+
+    for (int i = 0; i < L1_WAYS; i++) {
+        if (set[i].state == MESI_I) {
+            victim = &set[i];
+            break;
+        }
+        if (set[i].lru < victim->lru) {
+            victim = &set[i];
+        }
+    }
+
+    if (victim->state != MESI_I) {
+        cache->evictions += 1;
+        if (victim->state == MESI_M) {
+            cache->writebacks += 1;
+        }
+    }
+
+    cache->stamp += 1;
+    victim->tag = line;
+    victim->state = MESI_I;
+    victim->lru = cache->stamp;
+
+    return victim;
+}
+
+void print_cache_stats(const Cache *cache) {
+    size_t accesses = cache->hits + cache->misses;
+    double miss_rate = accesses ? (double)cache->misses / accesses : 0.0;
+
+    printf("    L1: accesses=%lu hits=%lu misses=%lu (%.2f%%) evictions=%lu writebacks=%lu invalidations=%lu\n",
+           accesses, cache->hits, cache->misses, miss_rate * 100.0,
+           cache->evictions, cache->writebacks, cache->invalidations);
+}
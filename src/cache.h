@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cpu_settings.h"
+
+// MESI coherence state of a cache line
+typedef enum {
+    MESI_I, // Invalid
+    MESI_S, // Shared
+    MESI_E, // Exclusive
+    MESI_M, // Modified
+} MesiState;
+
+typedef struct {
+    int tag;                    // Line address (address / L1_LINE_WORDS)
+    MesiState state;            // Coherence state
+    size_t lru;                 // Stamp of the last access
+    int data[L1_LINE_WORDS];    // Cached words
+} CacheLine;
+
+// Private set-associative L1 data cache
+typedef struct {
+    CacheLine lines[L1_SETS][L1_WAYS];
+    size_t stamp;               // Access counter used for LRU
+
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t writebacks;          // Modified lines evicted or downgraded
+    size_t invalidations;       // Lines invalidated by other cores
+} Cache;
+
+// Line address of a word address
+int cache_line_of(int address);
+
+// Returns the valid line holding `address` and updates LRU, or NULL on a miss.
+CacheLine *cache_lookup(Cache *cache, int address);
+
+// Returns the valid line holding `address` without touching LRU or statistics.
+CacheLine *cache_probe(Cache *cache, int address);
+
+// Picks a victim way for `address`, evicting it if needed, and returns it
+// tagged for the new line. The caller fills data and state.
+CacheLine *cache_allocate(Cache *cache, int address);
+
+void print_cache_stats(const Cache *cache);
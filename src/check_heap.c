@@ -0,0 +1,199 @@
+// Checks that stepping the simulation never touches the heap.
+//
+//      make check
+//
+// Every program in input/ is run through simulate_cycle() under each
+// pipeline option, as SMT threads, as multicore cores and from a recorded
+// trace. Any heap_alloc() or heap_free() made during a cycle is a failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "cpu.h"
+#include "memdep.h"
+#include "multicore.h"
+#include "storebuf.h"
+#include "trace.h"
+
+#define MEM_FILE    "input/memory_3_4.txt"
+#define TRACE_FILE  "check_heap.trace"
+#define MAX_CYCLES  1000000
+
+int debug_enabled = 0;
+
+static char *programs[] = {
+    "input/test_1.asm", "input/test_2.asm", "input/test_2_fixed.asm",
+    "input/test_3.asm", "input/test_3_fixed.asm", "input/test_4.asm",
+    "input/test_4_fixed.asm", "input/stream.asm", "input/sweep.asm",
+    "input/store_load.asm", "input/fused_move.asm",
+};
+#define NUM_PROGRAMS (int)(sizeof(programs) / sizeof(programs[0]))
+
+typedef struct {
+    const char *name;
+    int fetch_queue;
+    int memdep_mode;
+    bool eliminate;
+    bool fuse;
+    int store_buffer;
+    int drain;
+    int mshrs;
+} Options;
+
+static const Options options[] = {
+    { "default",      0, MEMDEP_IDEAL,      false, false, 0, SB_DRAIN_EAGER, 0 },
+    { "fetch-queue",  8, MEMDEP_IDEAL,      false, false, 0, SB_DRAIN_EAGER, 0 },
+    { "memdep-blind", 0, MEMDEP_BLIND,      false, false, 0, SB_DRAIN_EAGER, 0 },
+    { "storesets",    0, MEMDEP_STORE_SETS, false, false, 0, SB_DRAIN_EAGER, 0 },
+    { "eliminate",    0, MEMDEP_IDEAL,      true,  false, 0, SB_DRAIN_EAGER, 0 },
+    { "fuse",         0, MEMDEP_IDEAL,      false, true,  0, SB_DRAIN_EAGER, 0 },
+    { "sb-eager",     0, MEMDEP_IDEAL,      false, false, 8, SB_DRAIN_EAGER, 0 },
+    { "sb-lazy",      0, MEMDEP_IDEAL,      false, false, 8, SB_DRAIN_LAZY,  0 },
+    { "mshrs",        0, MEMDEP_IDEAL,      false, false, 0, SB_DRAIN_EAGER, 4 },
+    { "everything",   8, MEMDEP_STORE_SETS, true,  true,  8, SB_DRAIN_LAZY,  4 },
+};
+#define NUM_OPTIONS (int)(sizeof(options) / sizeof(options[0]))
+
+static int failures = 0;
+
+static void apply(Cpu *cpu, const Options *opt) {
+    cpu->fetch_queue_depth = opt->fetch_queue;
+    cpu->memdep_mode = opt->memdep_mode;
+    cpu->rename_elimination = opt->eliminate;
+    cpu->macro_fusion = opt->fuse;
+    sb_init(&cpu->store_buffer, opt->store_buffer, opt->drain);
+    mshr_init(&cpu->mshrs, opt->mshrs);
+}
+
+// Steps `cpu` until it halts, returns the heap calls made by the cycles
+static size_t run(Cpu *cpu) {
+    size_t calls = 0;
+
+    for (int i = 0; i < MAX_CYCLES; i++) {
+        size_t before = heap_calls();
+        bool halted = simulate_cycle(cpu);
+        calls += heap_calls() - before;
+
+        if (halted) break;
+    }
+
+    return calls;
+}
+
+static void report(const char *what, const char *program, const char *opt, size_t calls) {
+    if (calls == 0) return;
+
+    printf("FAIL %s %s (%s): %zu heap calls during cycles\n", what, program, opt, calls);
+    failures += 1;
+}
+
+static void check_single(void) {
+    static Cpu cpu;
+
+    for (int p = 0; p < NUM_PROGRAMS; p++) {
+        for (int o = 0; o < NUM_OPTIONS; o++) {
+            cpu = initialize_cpu(programs[p]);
+            apply(&cpu, &options[o]);
+            set_memory(&cpu, MEM_FILE);
+
+            report("single", programs[p], options[o].name, run(&cpu));
+            free_cpu(&cpu);
+        }
+    }
+}
+
+static void check_smt(void) {
+    static Cpu cpu;
+    int policies[] = { FETCH_ROUND_ROBIN, FETCH_ICOUNT };
+
+    for (int p = 0; p < NUM_PROGRAMS; p++) {
+        char *files[2] = { programs[p], programs[(p + 1) % NUM_PROGRAMS] };
+
+        for (int f = 0; f < 2; f++) {
+            for (int o = 0; o < NUM_OPTIONS; o++) {
+                cpu = initialize_smt_cpu(files, 2, policies[f]);
+                apply(&cpu, &options[o]);
+                set_memory(&cpu, MEM_FILE);
+
+                report(f == 0 ? "smt-rr" : "smt-icount", programs[p], options[o].name, run(&cpu));
+                free_cpu(&cpu);
+            }
+        }
+    }
+}
+
+// The cores are stepped on this thread, in core order, since heap_calls()
+// only counts the calling thread. Results only depend on the quantum.
+static void check_multicore(void) {
+    static MultiCore mc;
+
+    for (int p = 0; p < NUM_PROGRAMS; p++) {
+        char *files[2] = { programs[p], programs[(p + 1) % NUM_PROGRAMS] };
+
+        for (int o = 0; o < NUM_OPTIONS; o++) {
+            initialize_multicore(&mc, files, 2, 5);
+            multicore_set_memory(&mc, MEM_FILE);
+            for (int c = 0; c < mc.num_cores; c++) {
+                sb_init(&mc.cores[c].store_buffer, options[o].store_buffer, options[o].drain);
+            }
+
+            size_t calls = 0;
+            while (!mc.done) {
+                size_t before = heap_calls();
+                for (int c = 0; c < mc.num_cores; c++) {
+                    for (int i = 0; i < mc.quantum && !mc.halted[c]; i++) {
+                        mc.halted[c] = simulate_cycle(&mc.cores[c]);
+                    }
+                }
+                multicore_resolve_quantum(&mc);
+                calls += heap_calls() - before;
+            }
+
+            report("multicore", programs[p], options[o].name, calls);
+            multicore_free(&mc);
+        }
+    }
+}
+
+static void check_replay(void) {
+    static Cpu cpu;
+    static TraceWriter tw;
+    static TraceReader tr;
+    static int memory[DATA_MEMORY_SIZE];
+
+    read_memory_file(memory, MEM_FILE);
+
+    for (int p = 0; p < NUM_PROGRAMS; p++) {
+        Arena arena = arena_new(64 * 1024);
+        InstructionList code = parse(programs[p], &arena);
+        trace_record(&tw, TRACE_FILE, &code, memory);
+        arena_release(&arena);
+
+        cpu = initialize_cpu(programs[p]);
+        trace_open(&tr, TRACE_FILE, &cpu.threads[0].code);
+        cpu.trace = &tr;
+
+        report("replay", programs[p], "default", run(&cpu));
+        trace_close(&tr);
+        free_cpu(&cpu);
+    }
+
+    remove(TRACE_FILE);
+}
+
+int main(void) {
+    check_single();
+    check_smt();
+    check_multicore();
+    check_replay();
+
+    if (failures > 0) {
+        printf("%d runs used the heap during a cycle\n", failures);
+        return 1;
+    }
+
+    printf("No heap calls during %d programs x %d option sets\n", NUM_PROGRAMS, NUM_OPTIONS);
+    return 0;
+}
@@ -7,6 +7,8 @@
 #define SET_MEM     4
 #define SHOW_MEM    5
 #define QUIT        6
+#define RUN         7
+#define STATS       8
 
 #define STR_INITIALIZE  "Initialize"
 #define STR_SINGLE_STEP "Single_step"
@@ -14,4 +16,6 @@
 #define STR_DISPLAY     "Display"
 #define STR_SET_MEM     "SetMem"
 #define STR_SHOW_MEM    "ShowMem"
-#define STR_QUIT        "q"
\ No newline at end of file
+#define STR_QUIT        "q"
+#define STR_RUN         "Run"
+#define STR_STATS       "Stats"
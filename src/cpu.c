@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -11,35 +12,95 @@
 #include "rs.h"
 #include "util.h"
 #include "commands.h"
+#include "multicore.h"
+#include "tagmatch.h"
 
 Cpu initialize_cpu(char *asm_file)
 {
-    InstructionList inst_list =
-        parse(asm_file); // We will need to free this later
+    return initialize_smt_cpu(&asm_file, 1, FETCH_ROUND_ROBIN);
+}
+
+Cpu initialize_smt_cpu(char **asm_files, int num_threads, int fetch_policy)
+{
+    assert(num_threads >= 1 && num_threads <= SMT_MAX_THREADS && "Invalid number of hardware threads.");
+
+    // Picks the tag match kernel for this host, before any core thread runs
+    tagmatch_init();
 
     Cpu cpu = {0};
-    cpu.code = inst_list;
-    cpu.pc = 4000;
-    cpu.rt = initialize_rename_table();
-    cpu.rob.head = NULL;
+    cpu.arena = arena_new(64 * 1024);
+    cpu.num_threads = num_threads;
+    cpu.fetch_policy = fetch_policy;
+    cpu.last_fetched = num_threads - 1;
+    cpu.next_seq = 1;                   // 0 is older than everything, see flush_thread_after()
+    cpu.fetch_queue_depth = FETCH_QUEUE_DEPTH;
+    cpu.memdep_mode = MEMDEP_IDEAL;
+    cpu.rename_elimination = RENAME_ELIMINATION;
+    cpu.macro_fusion = MACRO_FUSION;
+    memdep_init(&cpu.memdep);
+    mshr_init(&cpu.mshrs, MSHR_COUNT);
+    sb_init(&cpu.store_buffer, STORE_BUFFER_DEPTH, SB_DRAIN_EAGER);
+    cpu.next_sample = LONG_MAX;
+    cpu.series_next = LONG_MAX;
+    cpu.live_next = LONG_MAX;
+
+    for (int t = 0; t < num_threads; t++)
+    {
+        HwThread *thread = &cpu.threads[t];
+
+        thread->code = parse(asm_files[t], &cpu.arena);
+        for (size_t i = 0; i < thread->code.len; i++)
+        {
+            thread->code.data[i].thread = t;
+        }
+        analyze_program(&thread->code, &cpu.arena);
 
-    memset(&cpu.uprf_valid, 1, sizeof(int) * PHYS_REGS_COUNT);
-    memset(&cpu.ucrf_valid, 1, sizeof(int) * CC_REGS_COUNT);
+        thread->pc = 4000;
+        thread->rt = initialize_rename_table(t);
+    }
+
+    rob_partition(&cpu.rob, num_threads);
+
+    memset(&cpu.uprf_valid, 1, sizeof(int) * UPRF_SIZE);
+    memset(&cpu.ucrf_valid, 1, sizeof(int) * UCRF_SIZE);
 
     return cpu;
 }
 
-int get_urpf_value(Cpu cpu, int phy_reg, int *dest)
+void free_cpu(Cpu *cpu)
+{
+    arena_release(&cpu->arena);
+
+    for (int t = 0; t < cpu->num_threads; t++)
+    {
+        cpu->threads[t].code = (InstructionList){0};
+    }
+}
+
+void load_emulator_state(Cpu *cpu, const Emulator *emu)
+{
+    load_thread_state(cpu, 0, emu->pc, emu->regs, emu->cc);
+
+    // Stores buffered in the previous window would drain over the new memory
+    sb_init(&cpu->store_buffer, cpu->store_buffer.depth, cpu->store_buffer.policy);
+    cpu->commit_stall = 0;
+    memcpy(cpu->memory, emu->memory, sizeof(cpu->memory));
+
+    cpu->committed = emu->executed;
+    cpu->threads[0].committed = emu->executed;
+}
+
+int get_urpf_value(const Cpu *cpu, int phy_reg, int *dest)
 {
-    if (phy_reg >= PHYS_REGS_COUNT)
+    if (phy_reg >= UPRF_SIZE)
     {
         DBG("ERROR", "Tried to read value of P%d.", phy_reg);
         return false;
     }
 
-    if (cpu.uprf_valid[phy_reg])
+    if (cpu->uprf_valid[phy_reg])
     {
-        *dest = cpu.uprf[phy_reg];
+        *dest = cpu->uprf[phy_reg];
 
         return true;
     }
@@ -47,17 +108,17 @@ int get_urpf_value(Cpu cpu, int phy_reg, int *dest)
     return false;
 }
 
-int get_ucrf_value(Cpu cpu, int cc, Cc *dest)
+int get_ucrf_value(const Cpu *cpu, int cc, Cc *dest)
 {
-    if (cc >= CC_REGS_COUNT)
+    if (cc >= UCRF_SIZE)
     {
         DBG("ERROR", "Tried to read value of C%d.", cc);
         return false;
     }
 
-    if (cpu.ucrf_valid[cc])
+    if (cpu->ucrf_valid[cc])
     {
-        *dest = cpu.ucrf[cc];
+        *dest = cpu->ucrf[cc];
 
         return true;
     }
@@ -67,6 +128,8 @@ int get_ucrf_value(Cpu cpu, int cc, Cc *dest)
 
 void forward_register(Cpu *cpu, int rd, int value)
 {
+    cpu->stats.energy[ENERGY_RS_WAKEUP] += 1;
+
     irs_send_forwarded_register(&cpu->irs, rd, value);
     mrs_send_forwarded_register(&cpu->mrs, rd, value);
     lsq_send_forwarded_register(&cpu->lsq, rd, value);
@@ -77,6 +140,10 @@ void forward_register(Cpu *cpu, int rd, int value)
 
 void forward_cc_register(Cpu *cpu, int cc, Cc value)
 {
+    cpu->stats.energy[ENERGY_RS_WAKEUP] += 1;
+
+    irs_send_forwarded_cc(&cpu->irs, cc, value);
+
     cpu->fw_ucrf_valid[cc] = true;
     cpu->fw_ucrf[cc] = value;
 }
@@ -99,42 +166,237 @@ void set_cc_flags(IQE *iqe)
     }
 }
 
-void flush_cpu_after(Cpu *cpu, int pc)
+// Frees the registers allocated at rename, -1 if none
+void release_registers(RenameTable *rt, int rd, int cc)
+{
+    if (rd != -1)
+        release_register(rt, rd);
+    if (cc != -1)
+        fl_push(&rt->ucrf_fl, cc);
+}
+
+static Instruction *fetch_queue_at(FetchQueue *fq, int i)
 {
-    cpu->fetch.has_inst = false;
-    cpu->decode_1.has_inst = false;
-    cpu->decode_2.has_inst = false;
+    return &fq->entries[(fq->head + i) % FETCH_QUEUE_MAX];
+}
+
+// Drops the thread's instructions from the fetch queue, keeping the order of the others
+static void fetch_queue_remove_thread(FetchQueue *fq, int thread)
+{
+    int kept = 0;
 
-    if (cpu->intFU.has_inst && cpu->intFU.iqe->pc > pc)
+    for (int i = 0; i < fq->len; i++)
+    {
+        Instruction *inst = fetch_queue_at(fq, i);
+        if (inst->thread != thread)
+            *fetch_queue_at(fq, kept++) = *inst;
+    }
+
+    fq->len = kept;
+}
+
+// True if `iqe` belongs to `thread` and was dispatched after `seq`
+static bool squashed_by(const IQE *iqe, int thread, uint64_t seq)
+{
+    return iqe->thread == thread && iqe->seq > seq;
+}
+
+// Squashes everything of the thread younger than `branch` (all of the
+// thread's instructions if it is NULL). Age is the dispatch sequence number:
+// comparing pcs goes wrong as soon as a backward branch puts a lower pc in
+// flight. Only the squashed entries are visited.
+void flush_thread_after(Cpu *cpu, int thread, IQE *branch)
+{
+    RenameTable *rt = &cpu->threads[thread].rt;
+    uint64_t seq = branch != NULL ? branch->seq : 0;
+
+    cpu->stats.energy[ENERGY_FLUSH] += 1;
+
+    // Decode 2 may hold registers allocated for an instruction not yet dispatched
+    if (cpu->decode_2.has_inst && cpu->decode_2.inst.thread == thread && cpu->decode_2.renamed)
+    {
+        release_registers(rt, cpu->decode_2.inst.rd, cpu->decode_2.inst.prev_cc != -1 ? cpu->decode_2.inst.cc : -1);
+    }
+
+    CpuStage *stages[] = { &cpu->fetch, &cpu->decode_1, &cpu->decode_2 };
+    for (int i = 0; i < 3; i++)
+    {
+        if (stages[i]->has_inst && stages[i]->inst.thread == thread)
+        {
+            stages[i]->has_inst = false;
+            stages[i]->renamed = false;
+        }
+    }
+    fetch_queue_remove_thread(&cpu->fetch_queue, thread);
+
+    // Squashed instructions give back the registers they allocated,
+    // walking the ROB from the youngest entry back to the branch
+    for (int i = cpu->rob.part[thread].len - 1; i >= 0; i--)
+    {
+        IQE *iqe = rob_entry(&cpu->rob, thread, i);
+        if (iqe->seq <= seq)
+            break;
+
+        release_registers(rt, iqe->rd, iqe->prev_cc != -1 ? iqe->cc : -1);
+    }
+
+    if (cpu->intFU.has_inst && squashed_by(cpu->intFU.iqe, thread, seq))
     {
         cpu->intFU.has_inst = false;
     }
-    if (cpu->mulFU.has_inst && cpu->mulFU.iqe->pc > pc)
+    if (cpu->mulFU.has_inst && squashed_by(cpu->mulFU.iqe, thread, seq))
     {
         cpu->mulFU.has_inst = false;
     }
-    if (cpu->memFU.has_inst && cpu->memFU.iqe->pc > pc)
+    if (cpu->memFU.has_inst && squashed_by(cpu->memFU.iqe, thread, seq))
     {
         cpu->memFU.has_inst = false;
     }
 
     // Flush IRS, LSQ, MRS
-    irs_flush_after(&cpu->irs, pc);
-    mrs_flush_after(&cpu->mrs, pc);
-    lsq_flush_after(&cpu->lsq, pc);
+    irs_flush_after(&cpu->irs, thread, seq);
+    mrs_flush_after(&cpu->mrs, thread, seq);
+    lsq_flush_after(&cpu->lsq, thread, seq);
 
     // Flush ROB
-    rob_flush_after(&cpu->rob, pc);
+    rob_flush_after(&cpu->rob, thread, branch);
+    memdep_flush(&cpu->memdep, thread, seq);
+
+    // A HALT fetched on the squashed path no longer stops fetch
+    cpu->threads[thread].fetch_stopped = false;
+
+    // Replaying, fetch goes back to the record after the branch
+    if (branch != NULL && branch->trace_index != -1)
+    {
+        cpu->threads[thread].trace_next = branch->trace_index + 1;
+        cpu->threads[thread].trace_wrong_path = false;
+    }
 }
 
-void reset_cpu_from_bis(Cpu *cpu, BisEntry bis_entry)
+void flush_cpu_after(Cpu *cpu, IQE *branch)
 {
-    cpu->rt = bis_entry.rt;
+    cpu->stats.flushes += 1;
+    flush_thread_after(cpu, branch->thread, branch);
+}
 
-    memcpy(cpu->fw_ucrf, bis_entry.fw_ucrf, sizeof(Cc) * CC_REGS_COUNT);
-    memcpy(cpu->fw_ucrf_valid, bis_entry.fw_ucrf_valid, sizeof(int) * CC_REGS_COUNT);
-    memcpy(cpu->fw_uprf, bis_entry.fw_uprf, sizeof(int) * PHYS_REGS_COUNT);
-    memcpy(cpu->fw_uprf_valid, bis_entry.fw_uprf_valid, sizeof(int) * PHYS_REGS_COUNT);
+// Squashes `load` and everything of its thread after it, fetch restarts at
+// the load. Loads have no rename snapshot, so the renames are undone one
+// by one from the youngest.
+static void squash_from(Cpu *cpu, IQE *load)
+{
+    int t = load->thread;
+    HwThread *thread = &cpu->threads[t];
+    IQE *before = NULL;
+
+    if (cpu->decode_2.has_inst && cpu->decode_2.inst.thread == t && cpu->decode_2.renamed)
+    {
+        undo_rename(&thread->rt, cpu->decode_2.inst.arch_rd, cpu->decode_2.inst.prev_rd, cpu->decode_2.inst.prev_cc);
+    }
+
+    for (int i = cpu->rob.part[t].len - 1; i >= 0; i--)
+    {
+        IQE *iqe = rob_entry(&cpu->rob, t, i);
+        if (iqe->seq < load->seq)
+        {
+            before = iqe;
+            break;
+        }
+
+        undo_rename(&thread->rt, iqe->arch_rd, iqe->prev_rd, iqe->prev_cc);
+    }
+
+    int pc = load->pc;
+    long trace_index = load->trace_index;
+
+    cpu->stats.flushes += 1;
+    flush_thread_after(cpu, t, before);
+    thread->pc = pc;
+    thread->trace_next = trace_index;
+    thread->trace_wrong_path = trace_index == -1;
+}
+
+// A load or store has its address. Loads read memory at execute, so a
+// younger load to the same address that got there first read a stale
+// value, unless a store in between already wrote it.
+static void resolve_memory_order(Cpu *cpu, IQE *iqe)
+{
+    StoreSets *ss = &cpu->memdep;
+
+    if (is_load(iqe->op) && iqe->dep_address != -1)
+    {
+        if (iqe->dep_address == iqe->result_buffer)
+            ss->avoided += 1;
+        else
+            ss->false_deps += 1;
+    }
+
+    if (!is_store(iqe->op))
+        return;
+
+    memdep_store_resolved(ss, iqe);
+    lsq_send_store_address(cpu, iqe);
+
+    int t = iqe->thread;
+    for (int i = 0; i < cpu->rob.part[t].len; i++)
+    {
+        IQE *younger = rob_entry(&cpu->rob, t, i);
+        if (younger->seq <= iqe->seq || !younger->completed || younger->result_buffer != iqe->result_buffer)
+            continue;
+
+        if (is_store(younger->op))
+            break;
+
+        if (is_load(younger->op))
+        {
+            DBG("INFO", "Load at pc %d read address %d before the store at pc %d", younger->pc, iqe->result_buffer, iqe->pc);
+
+            ss->violations += 1;
+            if (cpu->memdep_mode == MEMDEP_STORE_SETS)
+                memdep_train(ss, iqe, younger);
+
+            squash_from(cpu, younger);
+            break;
+        }
+    }
+}
+
+void load_thread_state(Cpu *cpu, int thread, int pc, const int *regs, Cc cc)
+{
+    HwThread *th = &cpu->threads[thread];
+
+    flush_thread_after(cpu, thread, NULL);
+    th->rt = initialize_rename_table(thread);
+    th->pc = pc;
+    th->halted = false;
+    th->fetch_stopped = false;
+
+    // Forwarded values left in the partition would shadow the new ones
+    int phys_base = thread * PHYS_REGS_COUNT;
+    for (int p = phys_base; p < phys_base + PHYS_REGS_COUNT; p++)
+    {
+        cpu->uprf_valid[p] = true;
+        cpu->fw_uprf_valid[p] = false;
+    }
+    for (int r = 0; r < ARCH_REGS_COUNT; r++)
+    {
+        cpu->uprf[th->rt.table[r]] = regs[r];
+    }
+
+    int cc_base = thread * CC_REGS_COUNT;
+    for (int c = cc_base; c < cc_base + CC_REGS_COUNT; c++)
+    {
+        cpu->ucrf_valid[c] = true;
+        cpu->fw_ucrf_valid[c] = false;
+    }
+    cpu->ucrf[th->rt.cc] = cc;
+}
+
+// Squashed registers went back to the free list and are invalidated when
+// reallocated, so only the mapping has to be restored. Rolling back the
+// forwarded values would lose results of older instructions.
+void reset_cpu_from_bis(Cpu *cpu, int thread, const BisEntry *bis_entry)
+{
+    restore_rename_mapping(&cpu->threads[thread].rt, bis_entry->table, bis_entry->cc);
 }
 
 // Convert pc from address space to index in instruction list
@@ -144,6 +406,79 @@ int pc_to_index(int pc) {
     return (pc - 4000) / 4; 
 }
 
+// Number of instructions of a thread in the front end and the stations
+int thread_icount(Cpu *cpu, int thread)
+{
+    int count = 0;
+
+    CpuStage *stages[] = { &cpu->fetch, &cpu->decode_1, &cpu->decode_2 };
+    for (int i = 0; i < 3; i++)
+    {
+        count += stages[i]->has_inst && stages[i]->inst.thread == thread;
+    }
+
+    for (int i = 0; i < cpu->fetch_queue.len; i++)
+    {
+        count += fetch_queue_at(&cpu->fetch_queue, i)->thread == thread;
+    }
+
+    count += cpu->irs.thread_len[thread];
+    count += cpu->mrs.thread_len[thread];
+    count += cpu->lsq.thread_len[thread];
+
+    return count;
+}
+
+// Picks the thread to fetch from this cycle, -1 if no thread can fetch
+int select_fetch_thread(Cpu *cpu)
+{
+    int selected = -1;
+    int best_icount = 0;
+
+    for (int i = 1; i <= cpu->num_threads; i++)
+    {
+        // Round robin order starting after the last fetched thread
+        int t = (cpu->last_fetched + i) % cpu->num_threads;
+        HwThread *thread = &cpu->threads[t];
+
+        if (thread->halted || thread->fetch_stopped)
+            continue;
+
+        if (cpu->fetch_policy == FETCH_ROUND_ROBIN)
+            return t;
+
+        int icount = thread_icount(cpu, t);
+        if (selected == -1 || icount < best_icount)
+        {
+            selected = t;
+            best_icount = icount;
+        }
+    }
+
+    return selected;
+}
+
+// Pairs a fetched instruction with the next record of the replayed trace.
+// Past a record that leaves the fall-through path, fetch is on the wrong
+// path until the redirect and what it fetches gets no record.
+static void trace_attach(Cpu *cpu, HwThread *thread, Instruction *inst)
+{
+    inst->trace_index = -1;
+    if (thread->trace_wrong_path)
+        return;
+
+    const TraceRecord *rec = trace_get(cpu->trace, thread->trace_next);
+    if (rec == NULL || rec->pc != inst->pc)
+    {
+        DBG("WARN", "Trace does not go through pc %d", inst->pc);
+        thread->trace_wrong_path = true;
+        return;
+    }
+
+    inst->trace_index = thread->trace_next++;
+    thread->trace_wrong_path = rec->next_pc != inst->next_pc;
+}
+
 // Fetch stage
 void fetch(Cpu *cpu)
 {
@@ -151,44 +486,123 @@ void fetch(Cpu *cpu)
     if (cpu->fetch.has_inst)
         return;
 
-    int index = pc_to_index(cpu->pc);
+    int t = select_fetch_thread(cpu);
+    if (t == -1)
+        return;
+
+    HwThread *thread = &cpu->threads[t];
+    int index = pc_to_index(thread->pc);
 
-    if (index >= 0 && index < cpu->code.len)
+    if (index >= 0 && index < (int)thread->code.len)
     {
-        Instruction inst = cpu->code.data[index];
+        Instruction inst = thread->code.data[index];
 
         cpu->fetch.has_inst = true;
+        cpu->stats.energy[ENERGY_FETCH] += 1;
         cpu->fetch.inst = inst;
-        cpu->fetch.inst.pc = cpu->pc;
-        cpu->pc += 4; // Go to next instruction
-        cpu->fetch.inst.next_pc = cpu->pc;
+        cpu->fetch.inst.pc = thread->pc;
+        thread->pc += 4; // Go to next instruction
+        cpu->fetch.inst.next_pc = thread->pc;
+        cpu->last_fetched = t;
+
+        if (cpu->trace != NULL)
+        {
+            trace_attach(cpu, thread, &cpu->fetch.inst);
+        }
+
+        if (inst.op == OP_HALT)
+        {
+            thread->fetch_stopped = true;
+        }
     }
     else
     {
         cpu->fetch.has_inst = false;
 
-        DBG("WARN", "Invalid program counter: %d (index = %d)", cpu->pc, index);
+        DBG("WARN", "Invalid program counter: %d (index = %d)", thread->pc, index);
     }
 }
 
+// Instruction of `thread` that comes next out of fetch, NULL if there is none yet
+static Instruction *next_fetched(Cpu *cpu, int thread)
+{
+    FetchQueue *fq = &cpu->fetch_queue;
+
+    if (fq->len > 0)
+        return fq->entries[fq->head].thread == thread ? &fq->entries[fq->head] : NULL;
+
+    return cpu->fetch.has_inst && cpu->fetch.inst.thread == thread ? &cpu->fetch.inst : NULL;
+}
+
 void decode_1(Cpu *cpu)
 {
     if (!cpu->decode_1.has_inst)
         return;
 
-    // Currently Decode 1 does nothing
+    // A compare, ADDL or SUBL takes the conditional branch behind it: one
+    // IRS slot, ROB entry and IntFU pass for both. Replaying, each fetched
+    // instruction has its own trace record, so nothing is fused.
+    Instruction *inst = &cpu->decode_1.inst;
+    if (!cpu->macro_fusion || cpu->trace != NULL || inst->fused_op != -1)
+        return;
+
+    if (inst->op != OP_CMP && inst->op != OP_CML && inst->op != OP_ADDL && inst->op != OP_SUBL)
+        return;
+
+    Instruction *branch = next_fetched(cpu, inst->thread);
+    if (branch == NULL || !branch->info->reads_cc || branch->pc != inst->next_pc)
+        return;
+
+    inst->fused_op = branch->op;
+    inst->fused_imm = branch->imm;
+    inst->next_pc = branch->next_pc;
+    cpu->stats.fused += 1;
+
+    if (cpu->fetch_queue.len > 0)
+    {
+        cpu->fetch_queue.head = (cpu->fetch_queue.head + 1) % FETCH_QUEUE_MAX;
+        cpu->fetch_queue.len -= 1;
+    }
+    else
+    {
+        cpu->fetch.has_inst = false;
+    }
 }
 
 void decode_2(Cpu *cpu)
 {
-    if (!cpu->decode_2.has_inst)
+    if (!cpu->decode_2.has_inst || cpu->decode_2.renamed)
         return;
 
+    int t = cpu->decode_2.inst.thread;
+    RenameTable *rt = &cpu->threads[t].rt;
+
+    const StaticInfo *info = cpu->decode_2.inst.info;
+    // A fused branch still has to be resolved by the IntFU
+    bool eliminate = cpu->rename_elimination && cpu->decode_2.inst.fused_op == -1;
+    cpu->decode_2.inst.idiom = eliminate ? info->idiom : IDIOM_NONE;
+    cpu->decode_2.inst.arch_rd = cpu->decode_2.inst.rd;
+
+    // Wait for free registers before renaming anything, a move takes none
+    bool needs_reg = info->dest_mask != 0 && cpu->decode_2.inst.idiom != IDIOM_MOVE;
+    bool needs_cc = info->writes_cc;
+    if (!rename_can_allocate(rt, needs_reg, needs_cc))
+    {
+        cpu->stats.rename_stall_cycles += 1;
+        if (needs_reg && rt->uprf_fl.len == 0)
+            cpu->stats.rename_stall_uprf += 1;
+        if (needs_cc && rt->ucrf_fl.len == 0)
+            cpu->stats.rename_stall_ucrf += 1;
+
+        DBG("INFO", "Rename stalled, no free register for T%d", t);
+        return;
+    }
+
     if (cpu->decode_2.inst.rs1 != -1)
     {
         int temp = cpu->decode_2.inst.rs1;
         cpu->decode_2.inst.rs1 =
-            map_source_register(&cpu->rt, cpu->decode_2.inst.rs1);
+            map_source_register(rt, cpu->decode_2.inst.rs1);
         DBG("INFO", "Renamed Register R%d to P%d", temp, cpu->decode_2.inst.rs1);
     }
 
@@ -196,7 +610,7 @@ void decode_2(Cpu *cpu)
     {
         int temp = cpu->decode_2.inst.rs2;
         cpu->decode_2.inst.rs2 =
-            map_source_register(&cpu->rt, cpu->decode_2.inst.rs2);
+            map_source_register(rt, cpu->decode_2.inst.rs2);
         DBG("INFO", "Renamed Register R%d to P%d", temp, cpu->decode_2.inst.rs2);
     }
 
@@ -204,52 +618,131 @@ void decode_2(Cpu *cpu)
     {
         int temp = cpu->decode_2.inst.rs3;
         cpu->decode_2.inst.rs3 =
-            map_source_register(&cpu->rt, cpu->decode_2.inst.rs3);
+            map_source_register(rt, cpu->decode_2.inst.rs3);
         DBG("INFO", "Renamed Register R%d to P%d", temp, cpu->decode_2.inst.rs3);
     }
 
-    // Renaming registers
-    if (cpu->decode_2.inst.rd != -1)
+    // Renaming registers, the old mappings are freed when this instruction commits
+    if (cpu->decode_2.inst.idiom == IDIOM_MOVE)
+    {
+        // rd names the source's register, which already has or will get the value
+        int temp = cpu->decode_2.inst.rd;
+        cpu->decode_2.inst.rd = map_alias_register(rt, cpu->decode_2.inst.rd, cpu->decode_2.inst.rs1, &cpu->decode_2.inst.prev_rd);
+        DBG("INFO", "Eliminated move, R%d shares P%d", temp, cpu->decode_2.inst.rd);
+    }
+    else if (cpu->decode_2.inst.rd != -1)
     {
         int temp = cpu->decode_2.inst.rd;
-        cpu->decode_2.inst.rd = map_dest_register(&cpu->rt, cpu->decode_2.inst.rd);
+        cpu->decode_2.inst.rd = map_dest_register(rt, cpu->decode_2.inst.rd, &cpu->decode_2.inst.prev_rd);
 
         cpu->uprf_valid[cpu->decode_2.inst.rd] = false;
         cpu->fw_uprf_valid[cpu->decode_2.inst.rd] = false;
         DBG("INFO", "Renamed Register R%d to P%d", temp, cpu->decode_2.inst.rd);
     }
 
-    cpu->decode_2.inst.cc = get_cc_register(&cpu->rt);
-    switch (cpu->decode_2.inst.op)
+    cpu->decode_2.inst.cc = get_cc_register(rt);
+    if (needs_cc)
+    {
+        cpu->decode_2.inst.cc = map_cc_register(rt, &cpu->decode_2.inst.prev_cc);
+
+        cpu->ucrf_valid[cpu->decode_2.inst.cc] = false;
+        cpu->fw_ucrf_valid[cpu->decode_2.inst.cc] = false;
+    }
+
+    cpu->decode_2.renamed = true;
+    cpu->stats.energy[ENERGY_RENAME] += 1;
+}
+
+// MOVC and zero idioms have their value at rename, so has a move whose
+// source is ready. They enter the ROB completed and skip the IRS.
+static bool complete_at_rename(Cpu *cpu, IQE *iqe)
+{
+    switch (iqe->idiom)
+    {
+    case IDIOM_MOVC:
+    {
+        iqe->result_buffer = iqe->imm;
+        break;
+    }
+    case IDIOM_ZERO:
+    {
+        iqe->result_buffer = 0;
+        break;
+    }
+    case IDIOM_MOVE:
+    {
+        // Otherwise the IntFU still has to compute its cc
+        if (!iqe->rs1_valid)
+            return false;
+
+        iqe->result_buffer = iqe->rs1_value;
+        break;
+    }
+    default:
     {
-    case OP_ADD:
-    case OP_SUB:
-    case OP_MUL:
-    case OP_DIV:
-    case OP_AND:
-    case OP_OR:
-    case OP_XOR:
-    case OP_ADDL:
-    case OP_SUBL:
+        return false;
+    }
+    }
+
+    forward_register(cpu, iqe->rd, iqe->result_buffer);
+    if (iqe->prev_cc != -1)
     {
-        cpu->decode_2.inst.cc = map_cc_register(&cpu->rt);
+        set_cc_flags(iqe);
+        forward_cc_register(cpu, iqe->cc, iqe->cc_value);
     }
+
+    iqe->completed = true;
+    return true;
+}
+
+// Whether a conditional branch at `pc` redirects fetch with flags `cc`.
+// Like the IntFU cases, BP, BN and BNP are only taken forward.
+static bool branch_redirects(int op, Cc cc, int pc, int imm)
+{
+    int target = pc + imm;
+
+    switch (op)
+    {
+    case OP_BZ:
+        return cc.z && target != pc + 4;
+    case OP_BNZ:
+        return !cc.z && target != pc + 4;
+    case OP_BP:
+        return cc.p && target > pc;
+    case OP_BN:
+        return cc.n && target > pc;
+    case OP_BNP:
+        return !cc.p && target > pc;
     }
 
-    cpu->decode_2.inst.bis_entry = (BisEntry){
-        .fw_ucrf_valid = {0},
-        .fw_ucrf = {0},
+    return false;
+}
 
-        .fw_uprf_valid = {0},
-        .fw_uprf = {0},
+// Resolves a replayed control instruction as recorded. Without a record,
+// on the wrong path, it falls through: its outcome would need values.
+static void replay_control(Cpu *cpu, IQE *iqe)
+{
+    int target;
 
-        .rt = cpu->rt,
-    };
+    if (iqe->op == OP_JALP)
+    {
+        target = iqe->pc + iqe->imm;
+    }
+    else if (iqe->info->needs_bis && iqe->op != OP_HALT && iqe->trace_index != -1)
+    {
+        // Jumps always redirect, branches only off the fall-through path
+        target = trace_get(cpu->trace, iqe->trace_index)->next_pc;
+        if (iqe->op != OP_JUMP && target == iqe->next_pc)
+            return;
+    }
+    else
+    {
+        return;
+    }
 
-    memcpy(cpu->decode_2.inst.bis_entry.fw_ucrf, cpu->fw_ucrf, sizeof(Cc) * CC_REGS_COUNT);
-    memcpy(cpu->decode_2.inst.bis_entry.fw_ucrf_valid, cpu->fw_ucrf_valid, sizeof(int) * CC_REGS_COUNT);
-    memcpy(cpu->decode_2.inst.bis_entry.fw_uprf, cpu->fw_uprf, sizeof(int) * PHYS_REGS_COUNT);
-    memcpy(cpu->decode_2.inst.bis_entry.fw_uprf_valid, cpu->fw_uprf_valid, sizeof(int) * PHYS_REGS_COUNT);
+    flush_cpu_after(cpu, iqe);
+    reset_cpu_from_bis(cpu, iqe->thread, rob_bis(&cpu->rob, iqe));
+    cpu->threads[iqe->thread].pc = target;
 }
 
 void int_fu(Cpu *cpu)
@@ -266,6 +759,15 @@ void int_fu(Cpu *cpu)
     {
         IQE *iqe = cpu->intFU.iqe;
 
+        if (cpu->trace != NULL)
+        {
+            replay_control(cpu, iqe);
+            return;
+        }
+
+        // CMP and CML leave cc alone, a branch fused behind them reads the one they read
+        Cc cc_read = iqe->cc_value;
+
         switch (iqe->op)
         {
         case OP_ADD:
@@ -313,9 +815,9 @@ void int_fu(Cpu *cpu)
                 {
                     DBG("INFO", "Should flush BZ %c", ' ');
 
-                    flush_cpu_after(cpu, iqe->pc);
-                    reset_cpu_from_bis(cpu, iqe->bis_entry);
-                    cpu->pc = iqe->result_buffer;
+                    flush_cpu_after(cpu, iqe);
+                    reset_cpu_from_bis(cpu, iqe->thread, rob_bis(&cpu->rob, iqe));
+                    cpu->threads[iqe->thread].pc = iqe->result_buffer;
                 }
             }
             break;
@@ -330,9 +832,9 @@ void int_fu(Cpu *cpu)
                 {
                     DBG("INFO", "Should flush BNZ %c", ' ');
 
-                    flush_cpu_after(cpu, iqe->pc);
-                    reset_cpu_from_bis(cpu, iqe->bis_entry);
-                    cpu->pc = iqe->result_buffer;
+                    flush_cpu_after(cpu, iqe);
+                    reset_cpu_from_bis(cpu, iqe->thread, rob_bis(&cpu->rob, iqe));
+                    cpu->threads[iqe->thread].pc = iqe->result_buffer;
                 }
             }
             break;
@@ -381,9 +883,9 @@ void int_fu(Cpu *cpu)
                 if (iqe->result_buffer > iqe->pc)
                 {
                     DBG("INFO", "Should flush BP %c", ' ');
-                    flush_cpu_after(cpu, iqe->pc);
-                    reset_cpu_from_bis(cpu, iqe->bis_entry);
-                    cpu->pc = iqe->result_buffer;
+                    flush_cpu_after(cpu, iqe);
+                    reset_cpu_from_bis(cpu, iqe->thread, rob_bis(&cpu->rob, iqe));
+                    cpu->threads[iqe->thread].pc = iqe->result_buffer;
                 }
             }
             break;
@@ -396,9 +898,9 @@ void int_fu(Cpu *cpu)
                 if (iqe->result_buffer > iqe->pc)
                 {
                     DBG("INFO", "Should branch BN %c", ' ');
-                    flush_cpu_after(cpu, iqe->pc);
-                    reset_cpu_from_bis(cpu, iqe->bis_entry);
-                    cpu->pc = iqe->result_buffer;
+                    flush_cpu_after(cpu, iqe);
+                    reset_cpu_from_bis(cpu, iqe->thread, rob_bis(&cpu->rob, iqe));
+                    cpu->threads[iqe->thread].pc = iqe->result_buffer;
                 }
             }
             break;
@@ -411,9 +913,9 @@ void int_fu(Cpu *cpu)
                 if (iqe->result_buffer > iqe->pc)
                 {
                     DBG("INFO", "Should branch BNP %c", ' ');
-                    flush_cpu_after(cpu, iqe->pc);
-                    reset_cpu_from_bis(cpu, iqe->bis_entry);
-                    cpu->pc = iqe->result_buffer;
+                    flush_cpu_after(cpu, iqe);
+                    reset_cpu_from_bis(cpu, iqe->thread, rob_bis(&cpu->rob, iqe));
+                    cpu->threads[iqe->thread].pc = iqe->result_buffer;
                 }
             }
             break;
@@ -423,9 +925,9 @@ void int_fu(Cpu *cpu)
             iqe->result_buffer = iqe->rs1_value + iqe->imm;
 
             DBG("INFO", "Should jump JUMP to %d", iqe->result_buffer);
-            flush_cpu_after(cpu, iqe->pc);
-            reset_cpu_from_bis(cpu, iqe->bis_entry);
-            cpu->pc = iqe->result_buffer;
+            flush_cpu_after(cpu, iqe);
+            reset_cpu_from_bis(cpu, iqe->thread, rob_bis(&cpu->rob, iqe));
+            cpu->threads[iqe->thread].pc = iqe->result_buffer;
 
             break;
         }
@@ -435,9 +937,9 @@ void int_fu(Cpu *cpu)
             iqe->result_buffer = iqe->pc + 4;
 
             DBG("INFO", "Should jump JALP to %d with return address %d", jump_addr, iqe->result_buffer);
-            flush_cpu_after(cpu, iqe->pc);
-            reset_cpu_from_bis(cpu, iqe->bis_entry);
-            cpu->pc = jump_addr;
+            flush_cpu_after(cpu, iqe);
+            reset_cpu_from_bis(cpu, iqe->thread, rob_bis(&cpu->rob, iqe));
+            cpu->threads[iqe->thread].pc = jump_addr;
                 
             break;
         }
@@ -447,9 +949,9 @@ void int_fu(Cpu *cpu)
             if (iqe->next_pc != iqe->result_buffer)
             {
                 DBG("INFO", "Should flush JALP %c", ' ');
-                flush_cpu_after(cpu, iqe->pc);
-                reset_cpu_from_bis(cpu, iqe->bis_entry);
-                cpu->pc = iqe->result_buffer;
+                flush_cpu_after(cpu, iqe);
+                reset_cpu_from_bis(cpu, iqe->thread, rob_bis(&cpu->rob, iqe));
+                cpu->threads[iqe->thread].pc = iqe->result_buffer;
             }
             break;
         }
@@ -464,6 +966,21 @@ void int_fu(Cpu *cpu)
             DBG("WARN", "Invalid opcode `0x%x` found in IntFU.", cpu->intFU.iqe->op);
         }
         }
+
+        if (iqe->fused_op != -1)
+        {
+            int branch_pc = iqe->pc + 4;
+            Cc cc = iqe->info->writes_cc ? iqe->cc_value : cc_read;
+
+            if (branch_redirects(iqe->fused_op, cc, branch_pc, iqe->fused_imm))
+            {
+                DBG("INFO", "Should flush fused %s", get_op_name(iqe->fused_op));
+
+                flush_cpu_after(cpu, iqe);
+                reset_cpu_from_bis(cpu, iqe->thread, rob_bis(&cpu->rob, iqe));
+                cpu->threads[iqe->thread].pc = branch_pc + iqe->fused_imm;
+            }
+        }
     }
 }
 
@@ -480,6 +997,11 @@ void mul_fu(Cpu *cpu)
     if (cpu->mulFU.cycles == 0)
     {
         IQE *iqe = cpu->mulFU.iqe;
+
+        // Replaying, values are not computed
+        if (cpu->trace != NULL)
+            return;
+
         switch (iqe->op)
         {
         case OP_DIV:
@@ -516,6 +1038,13 @@ void mem_fu(Cpu *cpu)
     {
         IQE *iqe = cpu->memFU.iqe;
 
+        // Replaying, the address is the recorded one
+        if (cpu->trace != NULL)
+        {
+            iqe->result_buffer = iqe->trace_index != -1 ? trace_get(cpu->trace, iqe->trace_index)->address : 0;
+            return;
+        }
+
         switch (iqe->op)
         {
         case OP_LOAD:
@@ -547,17 +1076,83 @@ void mem_fu(Cpu *cpu)
     }
 }
 
-bool commit(Cpu *cpu)
+// An access slower than a hit missed in the L1
+static int charge_access(Cpu *cpu, int latency)
+{
+    cpu->stats.energy[ENERGY_MEM_ACCESS] += 1;
+    if (latency > 1)
+        cpu->stats.energy[ENERGY_MEM_MISS] += 1;
+
+    return latency;
+}
+
+// Data memory accesses made by commit. Cores of a MultiCore go through their
+// private cache; the returned latency stalls further commits.
+int read_memory(Cpu *cpu, int address, int *value)
+{
+    if (cpu->stack_profiler != NULL)
+    {
+        stackdist_access(cpu->stack_profiler, address);
+    }
+
+    if (cpu->mc != NULL)
+    {
+        return charge_access(cpu, multicore_read((MultiCore *)cpu->mc, cpu->core_id, address, value));
+    }
+
+    *value = cpu->memory[address];
+    return charge_access(cpu, 1);
+}
+
+int write_memory(Cpu *cpu, int address, int value)
+{
+    if (cpu->stack_profiler != NULL)
+    {
+        stackdist_access(cpu->stack_profiler, address);
+    }
+
+    if (cpu->mc != NULL)
+    {
+        return charge_access(cpu, multicore_write((MultiCore *)cpu->mc, cpu->core_id, address, value));
+    }
+
+    if (cpu->mshrs.count > 0)
+    {
+        mshr_store(&cpu->mshrs, address);
+    }
+
+    cpu->memory[address] = value;
+    return charge_access(cpu, 1);
+}
+
+// Retires the oldest instruction of a thread if it has completed
+void commit_thread(Cpu *cpu, int t)
 {
-    IQE iqe = {0};
-    bool halt = false;
+    HwThread *thread = &cpu->threads[t];
+    IQE *entry = rob_get_completed(&cpu->rob, t);
 
-    if (rob_get_completed(&cpu->rob, &iqe))
+    if (entry != NULL)
     {
+        IQE iqe = *entry;
+
+        cpu->stats.energy[ENERGY_ROB_READ] += 1;
+        if (iqe.rd != -1)
+            cpu->stats.energy[ENERGY_RF_WRITE] += 1;
+
+        // A fused pair retires both of its instructions
+        int retired = iqe.fused_op != -1 ? 2 : 1;
+        cpu->committed += retired;
+        thread->committed += retired;
+        if (iqe.fused_op != -1)
+            cpu->stats.fused_committed += 1;
+
         if (iqe.op == OP_HALT)
         {
-            reset_cpu_from_bis(cpu, iqe.bis_entry);
-            halt = true;
+            reset_cpu_from_bis(cpu, t, rob_bis(&cpu->rob, entry));
+            thread->halted = true;
+
+            // Whatever was fetched after HALT will never commit
+            flush_thread_after(cpu, t, NULL);
         }
 
         switch (iqe.op)
@@ -565,7 +1160,17 @@ bool commit(Cpu *cpu)
         case OP_LDR:
         case OP_LOAD:
         {
-            iqe.result_buffer = cpu->memory[iqe.result_buffer];
+            StoreBuffer *sb = &cpu->store_buffer;
+            if (sb->depth > 0 && sb_forward(sb, iqe.result_buffer, &iqe.result_buffer))
+            {
+                sb->forwarded += 1;
+            }
+            else
+            {
+                int latency = read_memory(cpu, iqe.result_buffer, &iqe.result_buffer);
+                cpu->commit_stall = latency - 1;
+                sb->port_taken = true;
+            }
 
             // Forward the value loaded
             forward_register(cpu, iqe.rd, iqe.result_buffer);
@@ -575,7 +1180,14 @@ bool commit(Cpu *cpu)
         case OP_STR:
         case OP_STORE:
         {
-            cpu->memory[iqe.result_buffer] = iqe.rs1_value;
+            if (cpu->store_buffer.depth > 0)
+            {
+                sb_push(&cpu->store_buffer, iqe.result_buffer, iqe.rs1_value);
+                break;
+            }
+
+            int latency = write_memory(cpu, iqe.result_buffer, iqe.rs1_value);
+            cpu->commit_stall = latency - 1;
 
             break;
         }
@@ -592,11 +1204,121 @@ bool commit(Cpu *cpu)
             cpu->uprf[iqe.rd] = iqe.result_buffer;
         }
 
-        cpu->ucrf_valid[iqe.cc] = true;
-        cpu->ucrf[iqe.cc] = iqe.cc_value;
+        // Only producers write the cc register, others just read it
+        if (iqe.prev_cc != -1)
+        {
+            cpu->ucrf_valid[iqe.cc] = true;
+            cpu->ucrf[iqe.cc] = iqe.cc_value;
+        }
+
+        // Nothing older can read the overwritten mappings anymore
+        release_registers(&thread->rt, iqe.prev_rd, iqe.prev_cc);
     }
+}
+
+// Whether the oldest instruction of a thread must wait for the store
+// buffer: a store when it is full, a load while a drain holds the port
+static bool store_buffer_blocks(Cpu *cpu, int t)
+{
+    StoreBuffer *sb = &cpu->store_buffer;
+    if (sb->depth == 0 || cpu->rob.part[t].len == 0)
+        return false;
+
+    IQE *head = rob_entry(&cpu->rob, t, 0);
+    int value;
 
-    return halt;
+    if (!head->completed)
+        return false;
+
+    if (is_store(head->op) && !sb_can_take(sb, head->result_buffer))
+    {
+        sb->full_stalls += 1;
+        return true;
+    }
+
+    if (is_load(head->op) && sb->busy > 0 && !sb_forward(sb, head->result_buffer, &value))
+    {
+        sb->port_stalls += 1;
+        return true;
+    }
+
+    return false;
+}
+
+// Writes the oldest store buffer entry when the memory port is free. The
+// words of a line go together and take as long as the slowest of them.
+static void drain_store_buffer(Cpu *cpu, bool flush)
+{
+    StoreBuffer *sb = &cpu->store_buffer;
+    bool port_taken = sb->port_taken;
+
+    sb->port_taken = false;
+    sb->occupancy += sb->len;
+
+    if (sb->busy > 0)
+    {
+        sb->busy -= 1;
+        return;
+    }
+
+    if (port_taken || cpu->commit_stall > 0 || !sb_should_drain(sb, flush))
+        return;
+
+    SbEntry e = sb_pop(sb);
+    int latency = 1;
+
+    for (int w = 0; w < L1_LINE_WORDS; w++)
+    {
+        if (e.mask & 1u << w)
+        {
+            int l = write_memory(cpu, e.line * L1_LINE_WORDS + w, e.words[w]);
+            if (l > latency)
+                latency = l;
+        }
+    }
+
+    sb->busy = latency - 1;
+}
+
+// Commits at most one instruction per hardware thread.
+// Returns `true` once every thread has committed its HALT and the store
+// buffer is empty.
+bool commit(Cpu *cpu)
+{
+    bool all_halted = true;
+
+    // A memory access of an earlier commit still holds the commit port
+    if (cpu->commit_stall > 0)
+    {
+        cpu->commit_stall -= 1;
+    }
+    else
+    {
+        for (int t = 0; t < cpu->num_threads; t++)
+        {
+            if (!cpu->threads[t].halted && !store_buffer_blocks(cpu, t))
+            {
+                commit_thread(cpu, t);
+            }
+
+            // The access just made blocks the remaining threads too
+            if (cpu->commit_stall > 0)
+                break;
+        }
+    }
+
+    for (int t = 0; t < cpu->num_threads; t++)
+    {
+        all_halted &= cpu->threads[t].halted;
+    }
+
+    if (cpu->store_buffer.depth > 0)
+    {
+        drain_store_buffer(cpu, all_halted);
+        return all_halted && cpu->store_buffer.len == 0 && cpu->store_buffer.busy == 0;
+    }
+
+    return all_halted;
 }
 
 // Forwards data from each stage in the pipeline to the next stage
@@ -632,11 +1354,33 @@ void forward_pipeline(Cpu *cpu)
         }
     }
 
-    // MemFU
+    // Misses whose line arrived complete their loads
+    if (cpu->mshrs.count > 0)
+    {
+        mshr_tick(&cpu->mshrs);
+    }
+
+    // MemFU, a load missing in the L1 goes on waiting in an MSHR
     if (cpu->memFU.has_inst && cpu->memFU.cycles == 0)
     {
-        cpu->memFU.has_inst = false;
-        cpu->memFU.iqe->completed = true;
+        IQE *iqe = cpu->memFU.iqe;
+        int access = cpu->mshrs.count > 0 && is_load(iqe->op) ? mshr_access(&cpu->mshrs, iqe) : MSHR_HIT;
+
+        if (access == MSHR_MISS)
+        {
+            cpu->stats.energy[ENERGY_MEM_MISS] += 1;
+        }
+
+        if (access != MSHR_STALL)
+        {
+            cpu->memFU.has_inst = false;
+            iqe->completed = access == MSHR_HIT;
+
+            if (cpu->memdep_mode != MEMDEP_IDEAL)
+            {
+                resolve_memory_order(cpu, iqe);
+            }
+        }
     }
 
     // IRS -> IntFU
@@ -649,6 +1393,7 @@ void forward_pipeline(Cpu *cpu)
             cpu->intFU.has_inst = true;
             cpu->intFU.iqe = iqe;
             cpu->intFU.cycles = INT_FU_STAGES;
+            cpu->stats.energy[ENERGY_INT_OP] += 1;
         }
     }
 
@@ -662,6 +1407,7 @@ void forward_pipeline(Cpu *cpu)
             cpu->mulFU.has_inst = true;
             cpu->mulFU.iqe = iqe;
             cpu->mulFU.cycles = MUL_FU_STAGES;
+            cpu->stats.energy[ENERGY_MUL_OP] += 1;
         }
     }
 
@@ -675,30 +1421,62 @@ void forward_pipeline(Cpu *cpu)
             cpu->memFU.has_inst = true;
             cpu->memFU.iqe = iqe;
             cpu->memFU.cycles = MEM_FU_STAGES;
+            cpu->stats.energy[ENERGY_MEM_OP] += 1;
         }
     }
 
     // Decode 2 -> Reservation Station & ROB
     if (cpu->decode_2.has_inst)
     {
+        // Rename is waiting for free registers, so we stall all previous stages
+        if (!cpu->decode_2.renamed)
+            return;
+
         IQE iqe = make_iqe((void *)cpu, cpu->decode_2.inst);
+        iqe.seq = cpu->next_seq;
+
         IQE *rob_loc = rob_push_iqe(&cpu->rob, iqe);
+        RobPartition *rob_part = &cpu->rob.part[iqe.thread];
 
         if (rob_loc == 0)
         {
-            DBG("ERROR", "ROB was full. %c", ' ');
-            exit(1);
+            // The ROB was full, so we stall all previous stages
+            DBG("INFO", "ROB was full. %c", ' ');
+            return;
+        }
+        DBG("INFO", "ROB len: %d", rob_part->len);
+
+        // Decode 2 holds one instruction, so the thread's mapping is still
+        // the one right after this instruction renamed
+        if (iqe.info->needs_bis || iqe.fused_op != -1)
+        {
+            BisEntry *bis = rob_bis(&cpu->rob, rob_loc);
+            RenameTable *rt = &cpu->threads[iqe.thread].rt;
+
+            memcpy(bis->table, rt->table, sizeof(bis->table));
+            bis->cc = rt->cc;
         }
-        DBG("INFO", "ROB len: %d", cpu->rob.len);
 
-        if (send_to_reservation_station((void *)cpu, rob_loc))
+        if (complete_at_rename(cpu, rob_loc) || send_to_reservation_station((void *)cpu, rob_loc))
         {
+            cpu->stats.idioms[rob_loc->idiom] += 1;
+            if (rob_loc->completed)
+                cpu->stats.finished_at_rename += 1;
+            else
+                cpu->stats.energy[ENERGY_RS_WRITE] += 1;
+
+            cpu->stats.energy[ENERGY_ROB_WRITE] += 1;
+            cpu->stats.energy[ENERGY_RF_READ] += iqe.info->num_sources;
+
+            cpu->next_seq += 1;
             cpu->decode_2.has_inst = false;
+            cpu->decode_2.renamed = false;
         }
         else
         {
             // The reservation station was full, so we could not forward
             // So we stall all previous stages
+            rob_remove_last(&cpu->rob, iqe.thread);
             return;
         }
     }
@@ -709,19 +1487,65 @@ void forward_pipeline(Cpu *cpu)
         cpu->decode_1.has_inst = false;
 
         cpu->decode_2.has_inst = true;
+        cpu->decode_2.renamed = false;
         cpu->decode_2.inst = cpu->decode_1.inst;
     }
 
-    // Fetch -> Decode 1
-    if (cpu->fetch.has_inst)
+    // Fetch -> Decode 1, through the fetch queue once anything waits in it
+    if (cpu->fetch_queue_depth == 0 || cpu->fetch_queue.len == 0)
     {
-        cpu->fetch.has_inst = false;
+        if (cpu->fetch.has_inst)
+        {
+            cpu->fetch.has_inst = false;
+
+            cpu->decode_1.has_inst = true;
+            cpu->decode_1.inst = cpu->fetch.inst;
+        }
+        else
+        {
+            cpu->stats.decode_starved += 1;
+        }
+    }
+    else
+    {
+        FetchQueue *fq = &cpu->fetch_queue;
 
         cpu->decode_1.has_inst = true;
-        cpu->decode_1.inst = cpu->fetch.inst;
+        cpu->decode_1.inst = fq->entries[fq->head];
+        fq->head = (fq->head + 1) % FETCH_QUEUE_MAX;
+        fq->len -= 1;
     }
 }
 
+// Fetch -> fetch queue, when decode 1 could not take the instruction.
+// Unlike the other stages it goes on while the back end stalls, so fetch
+// runs ahead and a redirect refills the queue while older instructions
+// still drain from it.
+void fill_fetch_queue(Cpu *cpu)
+{
+    FetchQueue *fq = &cpu->fetch_queue;
+
+    if (cpu->fetch_queue_depth == 0)
+        return;
+
+    if (cpu->fetch.has_inst)
+    {
+        if (fq->len < cpu->fetch_queue_depth)
+        {
+            *fetch_queue_at(fq, fq->len) = cpu->fetch.inst;
+            fq->len += 1;
+            cpu->fetch.has_inst = false;
+        }
+        else
+        {
+            cpu->stats.fetch_queue_full += 1;
+        }
+    }
+
+    cpu->stats.fetch_queue_occupancy += fq->len;
+    cpu->stats.fetch_queue_hist[fq->len] += 1;
+}
+
 void print_stages(const Cpu *cpu)
 {
     if (!DEBUG)
@@ -738,6 +1562,12 @@ void print_stages(const Cpu *cpu)
         printf("No instruction.\n");
     }
 
+    // Fetch queue
+    if (cpu->fetch_queue_depth > 0)
+    {
+        printf("Fetch queue: %d/%d\n", cpu->fetch_queue.len, cpu->fetch_queue_depth);
+    }
+
     // Decode 1
     printf("Decode 1: ");
     if (cpu->decode_1.has_inst)
@@ -827,37 +1657,45 @@ void print_stages(const Cpu *cpu)
     }
 
     // ROB
-    printf("ROB: [ ");
-    RobNode *node = cpu->rob.head;
-    bool first_item_flag = true;
-    while (node != NULL)
+    for (int t = 0; t < cpu->num_threads; t++)
     {
-        if (first_item_flag)
+        if (cpu->num_threads > 1)
+            printf("ROB (T%d): [ ", t);
+        else
+            printf("ROB: [ ");
+
+        for (int i = 0; i < cpu->rob.part[t].len; i++)
         {
-            first_item_flag = false;
-            printf("\n");
+            if (i == 0)
+                printf("\n");
+            printf("       ");
+            print_iqe(rob_entry((Rob *)&cpu->rob, t, i));
         }
-        printf("       ");
-        print_iqe(&node->iqe);
-        node = node->next;
+        printf(" ]\n");
     }
-    printf(" ]\n");
 }
 
 void print_registers(const Cpu *cpu)
 {
-    printf("Registers:\n");
-    for (int i = 0; i < 4; i++)
+    for (int t = 0; t < cpu->num_threads; t++)
     {
-        printf("    ");
-        for (int j = 0; j < 8; j++)
+        if (cpu->num_threads > 1)
+            printf("Registers (T%d):\n", t);
+        else
+            printf("Registers:\n");
+
+        for (int i = 0; i < 4; i++)
         {
-            int arch_r = i * 8 + j;
-            int phy_r = cpu->rt.table[arch_r]; // Get current mapping for architectural register
-            int v = cpu->uprf[phy_r];
-            printf("R%d\t[%d]\t", arch_r, v);
+            printf("    ");
+            for (int j = 0; j < 8; j++)
+            {
+                int arch_r = i * 8 + j;
+                int phy_r = cpu->threads[t].rt.table[arch_r]; // Get current mapping for architectural register
+                int v = cpu->uprf[phy_r];
+                printf("R%d\t[%d]\t", arch_r, v);
+            }
+            printf("\n");
         }
-        printf("\n");
     }
 }
 
@@ -871,9 +1709,98 @@ void print_data_memory(const Cpu *cpu)
     }
 }
 
+// Counters the time series and the live stats sample
+static Sample read_counters(const Cpu *cpu)
+{
+    Sample now = {
+        .cycle = cpu->cycles,
+        .committed = cpu->committed,
+        .irs = cpu->irs.len,
+        .mrs = cpu->mrs.len,
+        .lsq = cpu->lsq.len,
+        .rename_stalls = cpu->stats.rename_stall_cycles,
+        .fetch_queue_full = cpu->stats.fetch_queue_full,
+        .decode_starved = cpu->stats.decode_starved,
+        .flushes = cpu->stats.flushes,
+        .sb_full_stalls = cpu->store_buffer.full_stalls,
+        .mshr_stalls = cpu->mshrs.stall_cycles,
+    };
+
+    for (int t = 0; t < cpu->num_threads; t++)
+    {
+        now.rob += cpu->rob.part[t].len;
+    }
+
+    const Cache *l1 = NULL;
+    if (cpu->mc != NULL)
+    {
+        l1 = &((MultiCore *)cpu->mc)->caches[cpu->core_id];
+    }
+    else if (cpu->mshrs.count > 0)
+    {
+        l1 = &cpu->mshrs.l1;
+    }
+
+    if (l1 != NULL)
+    {
+        now.l1_accesses = l1->hits + l1->misses;
+        now.l1_misses = l1->misses;
+    }
+
+    return now;
+}
+
+static void schedule_samples(Cpu *cpu)
+{
+    cpu->next_sample = cpu->series_next < cpu->live_next ? cpu->series_next : cpu->live_next;
+}
+
+void start_time_series(Cpu *cpu, TimeSeries *series)
+{
+    cpu->series = series;
+    cpu->series_next = series->interval;
+    schedule_samples(cpu);
+}
+
+void record_sample(Cpu *cpu)
+{
+    Sample now = read_counters(cpu);
+    cpu->series_next = ts_record(cpu->series, &now);
+    schedule_samples(cpu);
+}
+
+void start_live_stats(Cpu *cpu, LivePublisher *live)
+{
+    cpu->live = live;
+    cpu->live_next = 0;
+    publish_live_stats(cpu);
+}
+
+void publish_live_stats(Cpu *cpu)
+{
+    Sample now = read_counters(cpu);
+    cpu->live_next = live_publish(cpu->live, &now);
+    schedule_samples(cpu);
+}
+
+// Both kinds of sampling share the one comparison simulate_cycle makes
+static void take_samples(Cpu *cpu)
+{
+    if (cpu->cycles >= cpu->series_next)
+    {
+        record_sample(cpu);
+    }
+
+    if (cpu->cycles >= cpu->live_next)
+    {
+        publish_live_stats(cpu);
+    }
+}
+
 bool simulate_cycle(Cpu *cpu)
 {
     cpu->cycles += 1;
+    cpu->stats.energy[ENERGY_CYCLE] += 1;
     DBG("\nINFO",
         "==================== Cycle %d ====================", cpu->cycles);
 
@@ -899,16 +1826,120 @@ bool simulate_cycle(Cpu *cpu)
     bool sim_completed = commit(cpu);
 
     // Print stages
-    print_stages(cpu);
-    print_data_memory(cpu);
-    print_registers(cpu);
-    print_rename_table(cpu->rt);
+    if (DEBUG)
+    {
+        print_stages(cpu);
+        print_data_memory(cpu);
+        print_registers(cpu);
+        for (int t = 0; t < cpu->num_threads; t++)
+        {
+            print_rename_table(cpu->threads[t].rt);
+        }
+    }
 
     // Forward data to next stage
     forward_pipeline(cpu);
+    fill_fetch_queue(cpu);
+
+    if (cpu->cycles >= cpu->next_sample)
+    {
+        take_samples(cpu);
+    }
 
     return sim_completed;
 }
+
+int simulate_interval(Cpu *cpu, const Emulator *emu, long start, long end)
+{
+    load_emulator_state(cpu, emu);
+
+    int start_cycle = cpu->committed >= start ? cpu->cycles : -1;
+    bool done = false;
+
+    while (!done && cpu->committed < end)
+    {
+        done = simulate_cycle(cpu);
+
+        if (start_cycle == -1 && cpu->committed >= start)
+        {
+            start_cycle = cpu->cycles;
+        }
+    }
+
+    return start_cycle == -1 ? 0 : cpu->cycles - start_cycle;
+}
+
+void print_smt_stats(const Cpu *cpu)
+{
+    printf("SMT: threads=%d fetch_policy=%s cycles=%d\n", cpu->num_threads,
+           cpu->fetch_policy == FETCH_ICOUNT ? "icount" : "round-robin", cpu->cycles);
+
+    for (int t = 0; t < cpu->num_threads; t++)
+    {
+        const HwThread *thread = &cpu->threads[t];
+        double ipc = cpu->cycles ? (double)thread->committed / cpu->cycles : 0.0;
+
+        printf("Thread %d: %s committed=%d IPC=%.3f\n",
+               t, thread->halted ? "halted" : "running", thread->committed, ipc);
+    }
+
+    double ipc = cpu->cycles ? (double)cpu->committed / cpu->cycles : 0.0;
+    printf("Aggregate: committed=%d IPC=%.3f\n", cpu->committed, ipc);
+    print_stats(cpu);
+}
+
+void print_stats(const Cpu *cpu)
+{
+    printf("    Rename: stall_cycles=%d uprf_empty=%d ucrf_empty=%d\n",
+           cpu->stats.rename_stall_cycles, cpu->stats.rename_stall_uprf, cpu->stats.rename_stall_ucrf);
+
+    if (cpu->rename_elimination)
+    {
+        printf("    Eliminated at rename: movc=%d zero_idioms=%d moves=%d skipped_irs=%d\n",
+               cpu->stats.idioms[IDIOM_MOVC], cpu->stats.idioms[IDIOM_ZERO], cpu->stats.idioms[IDIOM_MOVE],
+               cpu->stats.finished_at_rename);
+    }
+
+    if (cpu->macro_fusion)
+    {
+        printf("    Fusion: pairs=%d committed=%d (%.1f%% of committed instructions)\n",
+               cpu->stats.fused, cpu->stats.fused_committed,
+               cpu->committed ? 200.0 * cpu->stats.fused_committed / cpu->committed : 0.0);
+    }
+
+    if (cpu->memdep_mode != MEMDEP_IDEAL)
+    {
+        print_memdep_stats(&cpu->memdep, cpu->memdep_mode);
+    }
+
+    if (cpu->mshrs.count > 0)
+    {
+        print_mshr_stats(&cpu->mshrs);
+    }
+
+    if (cpu->store_buffer.depth > 0)
+    {
+        print_sb_stats(&cpu->store_buffer, cpu->cycles);
+    }
+
+    if (cpu->energy_model != NULL)
+    {
+        print_energy(cpu->energy_model, cpu->stats.energy, cpu->cycles, cpu->committed);
+    }
+
+    if (cpu->fetch_queue_depth > 0)
+    {
+        printf("    Fetch queue: depth=%d avg=%.2f full=%d decode_starved=%d occupancy=",
+               cpu->fetch_queue_depth, cpu->cycles ? (double)cpu->stats.fetch_queue_occupancy / cpu->cycles : 0.0,
+               cpu->stats.fetch_queue_full, cpu->stats.decode_starved);
+        for (int n = 0; n <= cpu->fetch_queue_depth; n++)
+        {
+            printf("%s%d", n ? "/" : "", cpu->stats.fetch_queue_hist[n]);
+        }
+        printf("\n");
+    }
+}
+
 void display(Cpu *cpu){
     if (cpu == NULL) {
         printf("Cpu was not initialized. Please run the 'Initialize' command.\n");
@@ -928,6 +1959,9 @@ void display(Cpu *cpu){
 
     // First 10 mem locations
     print_data_memory(cpu);
+
+    printf("----------\n%s\n----------\n", "Stats:");
+    print_stats(cpu);
 }
 
 void show_mem(Cpu *cpu, int address){
@@ -946,11 +1980,15 @@ void show_mem(Cpu *cpu, int address){
 }
 
 void set_memory(Cpu *cpu, char *filename){
-        if (cpu == NULL) {
+    if (cpu == NULL) {
         printf("Cpu was not initialized. Please run the 'Initialize' command.\n");
         return;
     }
-    
+
+    read_memory_file(cpu->memory, filename);
+}
+
+void read_memory_file(int *memory, char *filename){
     FILE *fp;
     size_t nread;
     size_t len = 0;
@@ -989,7 +2027,7 @@ void set_memory(Cpu *cpu, char *filename){
             printf("Too many values provided in memory file. Terminating early.\n");
             return;
         }
-        cpu->memory[data_memory_idx] = value; // Update data memory
+        memory[data_memory_idx] = value; // Update data memory
         data_memory_idx += 1;
 
         token = strtok(NULL, ",");
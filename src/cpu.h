@@ -2,13 +2,24 @@
 
 #include <stdbool.h>
 
+#include "analysis.h"
+#include "emulator.h"
+#include "energy.h"
 #include "instruction.h"
+#include "memdep.h"
+#include "mshr.h"
 #include "rename.h"
 #include "rob.h"
 #include "rs.h"
+#include "stackdist.h"
+#include "livestats.h"
+#include "storebuf.h"
+#include "timeseries.h"
+#include "trace.h"
 
 typedef struct {
     bool has_inst;
+    bool renamed;   // Decode 2 renamed the instruction, it waits to dispatch
     Instruction inst;
 } CpuStage;
 
@@ -18,27 +29,76 @@ typedef struct {
     int cycles;
 } CpuFU;
 
+// Fetched instructions waiting for decode 1, oldest at `head`
+typedef struct {
+    Instruction entries[FETCH_QUEUE_MAX];
+    int head;
+    int len;
+} FetchQueue;
+
+// Fetch policies for simultaneous multithreading
+#define FETCH_ROUND_ROBIN 0             // Rotate between threads every cycle
+#define FETCH_ICOUNT      1             // Thread with fewest instructions in the front end and stations
+
+// Architectural state of one hardware thread
 typedef struct {
     InstructionList code;               // List of instructions
 
-    int cycles;                         // Cycles counter
     int pc;                             // Program counter
+    RenameTable rt;                     // RenameTable and FreeList, inside the thread's partition
 
-    int memory[DATA_MEMORY_SIZE];       // Data memory
+    bool fetch_stopped;                 // HALT was fetched, wait for it to commit or get squashed
+    bool halted;                        // HALT was committed
+    int committed;                      // Committed instructions counter
+
+    long trace_next;                    // Replaying: record of the next instruction on the recorded path
+    bool trace_wrong_path;              // Replaying: fetch left the recorded path, nothing it fetches has a record
+} HwThread;
+
+typedef struct {
+    int rename_stall_cycles;            // Cycles decode 2 waited for a free register
+    int rename_stall_uprf;              // ... with the physical register free list empty
+    int rename_stall_ucrf;              // ... with the cc register free list empty
+    int idioms[IDIOM_MOVE + 1];         // Dispatched instructions of each IDIOM_*
+    int finished_at_rename;             // ... that completed without executing
+
+    int fused;                          // Pairs fused at decode 1
+    int fused_committed;                // ... that committed
 
-    int uprf_valid[PHYS_REGS_COUNT];    // UPRF valid bit
-    int uprf[PHYS_REGS_COUNT];          // UPRF
+    int flushes;                        // Squashes by a taken branch or a memory-order violation
 
-    int fw_uprf_valid[PHYS_REGS_COUNT]; // Forwarded registers valid bits
-    int fw_uprf[PHYS_REGS_COUNT];       // Forwarded registers 
+    long energy[ENERGY_EVENTS];         // Events of the energy model, by ENERGY_*
 
-    int ucrf_valid[CC_REGS_COUNT];      // UCRF Valid bit
-    Cc  ucrf[CC_REGS_COUNT];            // UCRF
+    long fetch_queue_occupancy;         // Entries summed over the cycles, for the average
+    int fetch_queue_hist[FETCH_QUEUE_MAX + 1]; // Cycles spent at each occupancy
+    int fetch_queue_full;               // Cycles fetch held an instruction the full queue could not take
+    int decode_starved;                 // Cycles decode 1 was free and nothing was fetched for it
+} CpuStats;
 
-    int fw_ucrf_valid[CC_REGS_COUNT];   // Forwarded CC registers valid bits
-    Cc fw_ucrf[CC_REGS_COUNT];          // Forwarded CC registers
+typedef struct {
+    int cycles;                         // Cycles counter
+    int committed;                      // Committed instructions counter (all threads)
+    uint64_t next_seq;                  // Sequence number of the next dispatched instruction
+
+    // Hardware threads
+    HwThread threads[SMT_MAX_THREADS];
+    int num_threads;
+    int fetch_policy;                   // FETCH_ROUND_ROBIN or FETCH_ICOUNT
+    int last_fetched;                   // Thread fetched from last
+
+    int memory[DATA_MEMORY_SIZE];       // Data memory
 
-    RenameTable rt;                     // RenameTable and FreeList
+    int uprf_valid[UPRF_SIZE];          // UPRF valid bit
+    int uprf[UPRF_SIZE];                // UPRF
+
+    int fw_uprf_valid[UPRF_SIZE];       // Forwarded registers valid bits
+    int fw_uprf[UPRF_SIZE];             // Forwarded registers 
+
+    int ucrf_valid[UCRF_SIZE];          // UCRF Valid bit
+    Cc  ucrf[UCRF_SIZE];                // UCRF
+
+    int fw_ucrf_valid[UCRF_SIZE];       // Forwarded CC registers valid bits
+    Cc fw_ucrf[UCRF_SIZE];              // Forwarded CC registers
 
     // Reservation Stations
     IRS irs;
@@ -47,27 +107,89 @@ typedef struct {
 
     // Stages
     CpuStage fetch;
+    FetchQueue fetch_queue;
+    int fetch_queue_depth;              // Entries in use, 0 feeds decode 1 straight from fetch
     CpuStage decode_1;
+    bool macro_fusion;                  // Decode 1 fuses compares with the branch behind them
     CpuStage decode_2;
+    bool rename_elimination;            // Finish MOVC, zero idioms and moves at rename
 
     // Functional Units
     CpuFU intFU;
     CpuFU mulFU;
     CpuFU memFU;
 
-    // Reorder Buffer
+    // Reorder Buffer, partitioned between threads
     Rob rob;
+
+    int memdep_mode;                    // MEMDEP_IDEAL, MEMDEP_BLIND or MEMDEP_STORE_SETS
+    StoreSets memdep;
+
+    Mshrs mshrs;                        // L1 with non-blocking loads, when running alone
+    StoreBuffer store_buffer;           // Committed stores not yet in memory
+    const EnergyModel *energy_model;    // Costs of the energy report, NULL prints none
+    TimeSeries *series;                 // Counters sampled over the run, NULL if not sampling
+    LivePublisher *live;                // Shared-memory stats block, NULL if not publishing
+    long series_next;                   // Cycle of the next sample, LONG_MAX if none
+    long live_next;                     // Cycle of the next live update, LONG_MAX if none
+    long next_sample;                   // Earliest of the two
+
+    // Multicore
+    void *mc;                           // MultiCore this core belongs to (NULL when running alone)
+    int core_id;                        // Index of this core in the MultiCore
+    int commit_stall;                   // Cycles left before commit may retire again
+
+    // Trace replay: control flow and addresses come from the trace and no
+    // value is computed (NULL when executing the program)
+    TraceReader *trace;
+
+    StackProfiler *stack_profiler;      // Sees every data access of commit, NULL if not profiling
+
+    CpuStats stats;
+
+    Arena arena;                        // Programs and anything else living as long as the cpu
 } Cpu;
 
 Cpu initialize_cpu(char *asm_file);
 
+// Initializes a core running one program per hardware thread
+Cpu initialize_smt_cpu(char **asm_files, int num_threads, int fetch_policy);
+
+// Releases what the cpu allocated
+void free_cpu(Cpu *cpu);
+
+// Replaces a thread's state with architectural state: its instructions in
+// flight are dropped and every register gets its initial physical register
+void load_thread_state(Cpu *cpu, int thread, int pc, const int *regs, Cc cc);
+
+// Restarts a single-threaded core from where an emulator is: registers,
+// data memory and committed instructions. Cycles are left as they are.
+void load_emulator_state(Cpu *cpu, const Emulator *emu);
+
+// Restarts a single-threaded core from `emu` and simulates it up to
+// instruction `end` (or HALT). Returns the cycles instructions [start, end)
+// took, what runs before `start` only warms the pipeline up.
+int simulate_interval(Cpu *cpu, const Emulator *emu, long start, long end);
+
+// Samples the counters into `series` every series->interval cycles
+void start_time_series(Cpu *cpu, TimeSeries *series);
+
+// Records the counters now, also ends the last interval of a run
+void record_sample(Cpu *cpu);
+
+// Publishes the counters to `live` every live->interval cycles
+void start_live_stats(Cpu *cpu, LivePublisher *live);
+
+// Publishes the counters now
+void publish_live_stats(Cpu *cpu);
+
 // Updates dest with value of physical register if it is valid.
 // returns 0 if physical register was invalid.
-int get_urpf_value(Cpu cpu, int phy_reg, int *dest);
+int get_urpf_value(const Cpu *cpu, int phy_reg, int *dest);
 
 // Updates dest with value of cc register if it is valid.
 // returns 0 if physical register was invalid.
-int get_ucrf_value(Cpu cpu, int cc, Cc *dest);
+int get_ucrf_value(const Cpu *cpu, int cc, Cc *dest);
 
 // Simulates one cycle of the cpu
 //
@@ -77,6 +199,14 @@ bool simulate_cycle(Cpu *cpu);
 
 void display(Cpu *cpu);
 
+// Per-thread and aggregate IPC
+void print_smt_stats(const Cpu *cpu);
+
+void print_stats(const Cpu *cpu);
+
 void show_mem(Cpu *cpu, int address);
 
 void set_memory(Cpu *cpu, char *filename);
+
+// Reads comma separated values from `filename` into `memory`
+void read_memory_file(int *memory, char *filename);
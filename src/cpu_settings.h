@@ -2,15 +2,30 @@
 
 #define DATA_MEMORY_SIZE 4096
 
+#define SMT_MAX_THREADS 4
+
 #define PHYS_REGS_COUNT 60
 #define ARCH_REGS_COUNT 32
 #define CC_REGS_COUNT   10
 
+// Every hardware thread owns a partition of PHYS_REGS_COUNT physical and
+// CC_REGS_COUNT cc registers in the shared register files
+#define UPRF_SIZE (PHYS_REGS_COUNT * SMT_MAX_THREADS)
+#define UCRF_SIZE (CC_REGS_COUNT * SMT_MAX_THREADS)
+
 #define FREE_LIST_CAPACITY 60
 
+// Station sizes can be overridden at build time, e.g. for the tag match
+// benchmark: make cpu CPPFLAGS=-DIRS_CAPACITY=256
+#ifndef IRS_CAPACITY
 #define IRS_CAPACITY 8
+#endif
+#ifndef MRS_CAPACITY
 #define MRS_CAPACITY 2
+#endif
+#ifndef LSQ_CAPACITY
 #define LSQ_CAPACITY 6
+#endif
 
 #define INT_FU_STAGES 1
 #define MUL_FU_STAGES 4
@@ -18,4 +33,79 @@
 
 #define ROB_CAPACITY 80
 
-#define BIS_CAPACITY 60
\ No newline at end of file
+#define BIS_CAPACITY 60
+
+#define L1_SETS         16
+#define L1_WAYS         2
+#define L1_LINE_WORDS   4
+#define L1_MISS_PENALTY 10
+
+#define MULTICORE_MAX_CORES     8
+#define MULTICORE_QUANTUM       100
+#define MULTICORE_MAX_CYCLES    1000000
+
+#define EXTRAP_MAX_PERIOD       4       // Longest loop period looked for, in iterations
+
+// Default windows of the sampling mode, in instructions
+#define SAMPLE_UNIT             100
+#define SAMPLE_WARMUP           200
+#define SAMPLE_INTERVAL         10000
+#define SAMPLE_TARGET_ERROR     0.03
+
+// SimPoint region selection
+#define SIMPOINT_INTERVAL       1000    // Instructions per interval
+#define SIMPOINT_WARMUP         200     // Detailed instructions before a simulation point
+#define SIMPOINT_MAX_K          10      // Most clusters tried
+#define SIMPOINT_DIMS           15      // Basic-block vectors are projected down to this
+#define SIMPOINT_SEEDS          5       // k-means runs per k, the tightest one is kept
+
+// Interval-parallel simulation
+#define PARALLEL_INTERVAL       10000   // Instructions per interval
+#define PARALLEL_WARMUP         500     // Detailed instructions before each interval
+#define PARALLEL_MAX_JOBS       64
+
+// Queue between fetch and decode 1, 0 feeds decode 1 straight from fetch
+#define FETCH_QUEUE_DEPTH       0
+#define FETCH_QUEUE_MAX         16
+
+// MOVC, zero idioms and moves finished at rename, moves share their source's register
+#define RENAME_ELIMINATION      0
+
+// Compare, ADDL or SUBL fused with the conditional branch behind it at decode 1
+#define MACRO_FUSION            0
+
+// Store set memory dependence predictor
+#define MEMDEP_SSIT_SIZE        1024    // Store set ids, indexed by pc
+#define MEMDEP_LFST_SIZE        128     // Store sets
+#define MEMDEP_CLEAR_INTERVAL   100000  // Memory instructions between clears of the SSIT
+
+// Non-blocking loads, misses take L1_MISS_PENALTY cycles
+#define MSHR_COUNT              0       // 0 leaves loads without an L1 to miss in
+#define MSHR_MAX                16
+#define MSHR_TARGETS            4       // Loads waiting on one MSHR
+
+// Store buffer after commit, 0 writes stores to memory when they commit
+#define STORE_BUFFER_DEPTH      0
+#define STORE_BUFFER_MAX        32
+
+// Energy model, the run is timed at this clock
+#define ENERGY_FREQ_MHZ         1000
+
+// Interval time series
+#define TIME_SERIES_INTERVAL    1000    // Cycles per sample
+#define TIME_SERIES_SAMPLES     4096    // Samples kept, the interval doubles when they run out
+
+// Live statistics in shared memory
+#define LIVE_STATS_INTERVAL     50000   // Cycles between updates
+
+// Parsing, files are split between host threads in chunks of at least this many bytes
+#define PARSE_CHUNK_MIN_BYTES   (1 << 20)
+#define PARSE_MAX_THREADS       16
+
+// Execution traces
+#define TRACE_CHUNK_RECORDS     4096    // Records per chunk of the file
+#define TRACE_WINDOW            8192    // Decoded records kept while replaying, more than in flight
+
+// Stack distance cache profiling, lines are L1_LINE_WORDS words
+#define STACKDIST_SET_BITS      6       // Set counts profiled: 1, 2, 4 ... 64
+#define STACKDIST_MAX_WAYS      16      // Widest associativity reported
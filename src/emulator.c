@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+
+Emulator emu_new(const InstructionList *code, int *memory) {
+    return (Emulator){
+        .code = code,
+        .memory = memory,
+        .pc = 4000,
+    };
+}
+
+static Cc cc_of(int value) {
+    return (Cc){ .z = value == 0, .n = value < 0, .p = value > 0 };
+}
+
+static int *memory_word(Emulator *emu, int address) {
+    if (address < 0 || address >= DATA_MEMORY_SIZE) {
+        printf("Emulator: address %d out of data memory at pc %d\n", address, emu->pc);
+        exit(1);
+    }
+
+    return &emu->memory[address];
+}
+
+EmuStep emu_step(Emulator *emu) {
+    EmuStep step = { .pc = emu->pc, .op = OP_NOP, .next_pc = emu->pc, .address = -1 };
+    if (emu->halted) return step;
+
+    int index = (emu->pc - 4000) / 4;
+    if (index < 0 || index >= (int)emu->code->len) {
+        printf("Emulator: invalid program counter %d\n", emu->pc);
+        exit(1);
+    }
+
+    Instruction inst = emu->code->data[index];
+    int *r = emu->regs;
+    int next_pc = emu->pc + 4;
+
+    // Values of unused sources are never read
+    int rs1 = inst.rs1 != -1 ? r[inst.rs1] : 0;
+    int rs2 = inst.rs2 != -1 ? r[inst.rs2] : 0;
+    int rs3 = inst.rs3 != -1 ? r[inst.rs3] : 0;
+
+    switch (inst.op) {
+    case OP_ADD:  r[inst.rd] = rs1 + rs2;       emu->cc = cc_of(r[inst.rd]); break;
+    case OP_SUB:  r[inst.rd] = rs1 - rs2;       emu->cc = cc_of(r[inst.rd]); break;
+    case OP_MUL:  r[inst.rd] = rs1 * rs2;       emu->cc = cc_of(r[inst.rd]); break;
+    case OP_DIV:  r[inst.rd] = rs1 / rs2;       emu->cc = cc_of(r[inst.rd]); break;
+    case OP_AND:  r[inst.rd] = rs1 & rs2;       emu->cc = cc_of(r[inst.rd]); break;
+    case OP_OR:   r[inst.rd] = rs1 | rs2;       emu->cc = cc_of(r[inst.rd]); break;
+    case OP_XOR:  r[inst.rd] = rs1 ^ rs2;       emu->cc = cc_of(r[inst.rd]); break;
+    case OP_ADDL: r[inst.rd] = rs1 + inst.imm;  emu->cc = cc_of(r[inst.rd]); break;
+    case OP_SUBL: r[inst.rd] = rs1 - inst.imm;  emu->cc = cc_of(r[inst.rd]); break;
+    case OP_MOVC: r[inst.rd] = inst.imm; break;
+
+    case OP_LOAD:  step.address = rs1 + inst.imm; r[inst.rd] = *memory_word(emu, step.address); break;
+    case OP_LDR:   step.address = rs1 + rs2;      r[inst.rd] = *memory_word(emu, step.address); break;
+    case OP_STORE: step.address = rs2 + inst.imm; *memory_word(emu, step.address) = rs1; break;
+    case OP_STR:   step.address = rs2 + rs3;      *memory_word(emu, step.address) = rs1; break;
+
+    // Only writes_cc() instructions commit a cc register, CMP and CML don't
+    case OP_CMP:
+    case OP_CML:
+    case OP_NOP:
+        break;
+
+    case OP_BZ:  if (emu->cc.z)  next_pc = emu->pc + inst.imm; break;
+    case OP_BNZ: if (!emu->cc.z) next_pc = emu->pc + inst.imm; break;
+
+    // The IntFU only takes these when they branch forward
+    case OP_BP:  if (emu->cc.p  && inst.imm > 0) next_pc = emu->pc + inst.imm; break;
+    case OP_BN:  if (emu->cc.n  && inst.imm > 0) next_pc = emu->pc + inst.imm; break;
+    case OP_BNP: if (!emu->cc.p && inst.imm > 0) next_pc = emu->pc + inst.imm; break;
+
+    case OP_JUMP: next_pc = rs1 + inst.imm; break;
+    case OP_JALP:
+        r[inst.rd] = emu->pc + 4;
+        next_pc = emu->pc + inst.imm;
+        break;
+    case OP_RET: next_pc = rs1; break;
+
+    case OP_HALT:
+        emu->halted = true;
+        next_pc = emu->pc;
+        break;
+
+    default:
+        printf("Emulator: invalid opcode 0x%x at pc %d\n", inst.op, emu->pc);
+        exit(1);
+    }
+
+    emu->executed += 1;
+    emu->pc = next_pc;
+
+    step.op = inst.op;
+    step.next_pc = next_pc;
+
+    return step;
+}
+
+void checkpoint_save(Checkpoint *cp, const Emulator *emu) {
+    cp->emu = *emu;
+    cp->emu.memory = cp->memory;
+    memcpy(cp->memory, emu->memory, sizeof(cp->memory));
+}
+
+bool emu_is_back_edge(EmuStep step) {
+    switch (step.op) {
+    case OP_BZ:
+    case OP_BNZ:
+    case OP_JUMP:
+        return step.next_pc != step.pc + 4 && step.next_pc <= step.pc;
+    }
+
+    return false;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cpu_settings.h"
+#include "cpu_structs.h"
+#include "instruction.h"
+
+// Functional model of one hardware thread. It executes the program an
+// instruction at a time on architectural state, without any timing, and
+// follows the pipeline's semantics so both always agree on values.
+typedef struct {
+    const InstructionList *code;
+    int *memory;                    // DATA_MEMORY_SIZE words, owned by the caller
+
+    int pc;
+    int regs[ARCH_REGS_COUNT];
+    Cc cc;
+
+    bool halted;
+    size_t executed;                // Instructions executed, HALT included
+} Emulator;
+
+// What one step did, for callers following the control flow
+typedef struct {
+    int pc;
+    int op;
+    int next_pc;
+    int address;        // Data memory word accessed, -1 if none
+} EmuStep;
+
+// Emulator state with its own copy of data memory, to restart from later.
+// `emu.memory` points into the checkpoint, so it must not be copied.
+typedef struct {
+    Emulator emu;
+    int memory[DATA_MEMORY_SIZE];
+} Checkpoint;
+
+// Emulator at the start of `code`, with every register and flag cleared
+Emulator emu_new(const InstructionList *code, int *memory);
+
+// Executes one instruction, does nothing once halted
+EmuStep emu_step(Emulator *emu);
+
+void checkpoint_save(Checkpoint *cp, const Emulator *emu);
+
+// Taken conditional branch or jump to an address not after itself
+bool emu_is_back_edge(EmuStep step);
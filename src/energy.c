@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_settings.h"
+#include "energy.h"
+
+static const char *event_names[ENERGY_EVENTS] = {
+    [ENERGY_FETCH] = "fetch",
+    [ENERGY_RENAME] = "rename",
+    [ENERGY_RS_WRITE] = "rs_write",
+    [ENERGY_RS_WAKEUP] = "rs_wakeup",
+    [ENERGY_INT_OP] = "int_op",
+    [ENERGY_MUL_OP] = "mul_op",
+    [ENERGY_MEM_OP] = "mem_op",
+    [ENERGY_ROB_WRITE] = "rob_write",
+    [ENERGY_ROB_READ] = "rob_read",
+    [ENERGY_RF_READ] = "rf_read",
+    [ENERGY_RF_WRITE] = "rf_write",
+    [ENERGY_MEM_ACCESS] = "mem_access",
+    [ENERGY_MEM_MISS] = "mem_miss",
+    [ENERGY_FLUSH] = "flush",
+    [ENERGY_CYCLE] = "cycle",
+};
+
+// Rough figures for a small out-of-order core, in pJ. A miss is charged
+// on top of its access, a flush for the control logic only: the squashed
+// instructions already paid for what they did.
+EnergyModel energy_default(void) {
+    return (EnergyModel){
+        .cost = {
+            [ENERGY_FETCH] = 10.0,
+            [ENERGY_RENAME] = 4.0,
+            [ENERGY_RS_WRITE] = 3.0,
+            [ENERGY_RS_WAKEUP] = 2.5,
+            [ENERGY_INT_OP] = 4.0,
+            [ENERGY_MUL_OP] = 15.0,
+            [ENERGY_MEM_OP] = 3.0,
+            [ENERGY_ROB_WRITE] = 3.0,
+            [ENERGY_ROB_READ] = 2.0,
+            [ENERGY_RF_READ] = 2.0,
+            [ENERGY_RF_WRITE] = 3.0,
+            [ENERGY_MEM_ACCESS] = 20.0,
+            [ENERGY_MEM_MISS] = 200.0,
+            [ENERGY_FLUSH] = 10.0,
+            [ENERGY_CYCLE] = 15.0,
+        },
+        .freq_mhz = ENERGY_FREQ_MHZ,
+    };
+}
+
+void energy_load(EnergyModel *model, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        printf("Failed to open file %s.\n", path);
+        exit(1);
+    }
+
+    char line[256];
+    int line_no = 0;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line_no += 1;
+
+        char *comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+
+        char name[64];
+        double cost;
+        char extra;
+        int fields = sscanf(line, " %63s %lf %c", name, &cost, &extra);
+
+        if (fields <= 0)
+            continue;
+        if (fields != 2 || cost < 0) {
+            printf("%s:%d: expected `<event> <pJ>`.\n", path, line_no);
+            exit(1);
+        }
+
+        int e = 0;
+        while (e < ENERGY_EVENTS && strcmp(event_names[e], name) != 0) e++;
+        if (e == ENERGY_EVENTS) {
+            printf("%s:%d: unknown event `%s`.\n", path, line_no, name);
+            exit(1);
+        }
+
+        model->cost[e] = cost;
+    }
+
+    fclose(f);
+}
+
+void print_energy(const EnergyModel *model, const long *events, int cycles, int committed) {
+    double total_pj = 0.0;
+    for (int e = 0; e < ENERGY_EVENTS; e++) {
+        total_pj += model->cost[e] * events[e];
+    }
+
+    double seconds = cycles / (model->freq_mhz * 1e6);
+    double joules = total_pj * 1e-12;
+
+    printf("    Energy: total=%.3f nJ per_instruction=%.2f pJ power=%.3f mW at %.0f MHz EDP=%.4g J*s\n",
+           joules * 1e9, committed ? total_pj / committed : 0.0, seconds > 0 ? joules / seconds * 1e3 : 0.0,
+           model->freq_mhz, joules * seconds);
+
+    printf("      ");
+    for (int e = 0; e < ENERGY_EVENTS; e++) {
+        printf(" %s=%ld:%.1f%%", event_names[e], events[e],
+               total_pj > 0 ? 100.0 * model->cost[e] * events[e] / total_pj : 0.0);
+    }
+    printf(" (events:share)\n");
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// Events the energy model charges for, counted in CpuStats.energy
+#define ENERGY_FETCH       0    // Instruction fetched
+#define ENERGY_RENAME      1    // Instruction renamed
+#define ENERGY_RS_WRITE    2    // Entry written into a reservation station
+#define ENERGY_RS_WAKEUP   3    // Tag broadcast to the reservation stations
+#define ENERGY_INT_OP      4    // IntFU operation
+#define ENERGY_MUL_OP      5    // MulFU operation
+#define ENERGY_MEM_OP      6    // MemFU address computation
+#define ENERGY_ROB_WRITE   7    // Entry written into the ROB
+#define ENERGY_ROB_READ    8    // Entry read out of the ROB at commit
+#define ENERGY_RF_READ     9    // Source operand read at dispatch
+#define ENERGY_RF_WRITE    10   // Register written at commit
+#define ENERGY_MEM_ACCESS  11   // Data memory or L1 access
+#define ENERGY_MEM_MISS    12   // Access that missed in the L1
+#define ENERGY_FLUSH       13   // Pipeline flush
+#define ENERGY_CYCLE       14   // Clock and leakage, every cycle
+#define ENERGY_EVENTS      15
+
+// Energy of each event in pJ, and the clock the run is timed at
+typedef struct {
+    double cost[ENERGY_EVENTS];
+    double freq_mhz;
+} EnergyModel;
+
+// Default costs at ENERGY_FREQ_MHZ
+EnergyModel energy_default(void);
+
+// Overrides costs from a file of `<event> <pJ>` lines, `#` starts a
+// comment. Event names are the ones print_energy() reports. Exits on an
+// unknown event or a malformed line.
+void energy_load(EnergyModel *model, const char *path);
+
+// Total energy, average power and energy-delay product of a run
+void print_energy(const EnergyModel *model, const long *events, int cycles, int committed);
@@ -0,0 +1,294 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extrapolate.h"
+#include "macros.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+static uint64_t hash_int(uint64_t h, int64_t value) {
+    for (int i = 0; i < 8; i++) {
+        h ^= (uint64_t)(value >> (i * 8)) & 0xff;
+        h *= FNV_PRIME;
+    }
+
+    return h;
+}
+
+static uint64_t hash_stage(uint64_t h, const CpuStage *stage) {
+    h = hash_int(h, stage->has_inst);
+    if (stage->has_inst) {
+        h = hash_int(h, stage->inst.pc);
+        h = hash_int(h, stage->renamed);
+    }
+
+    return h;
+}
+
+// Which sources of each entry are pending, not which register they wait on
+static uint64_t hash_station(uint64_t h, IQE *const *queue, const int32_t *tags, int stride, int len) {
+    h = hash_int(h, len);
+    for (int i = 0; i < len; i++) {
+        int pending = 0;
+        for (int k = 0; k < TAG_ROWS; k++) {
+            pending |= (tags[k * stride + i] != -1) << k;
+        }
+
+        h = hash_int(h, queue[i]->pc);
+        h = hash_int(h, pending);
+    }
+
+    return h;
+}
+
+static uint64_t hash_fu(uint64_t h, const CpuFU *fu) {
+    h = hash_int(h, fu->has_inst);
+    if (fu->has_inst) {
+        h = hash_int(h, fu->iqe->pc);
+        h = hash_int(h, fu->cycles);
+    }
+
+    return h;
+}
+
+// Everything that decides the timing of what follows, for thread 0. Register
+// names and values are left out: they differ every iteration.
+static uint64_t hash_timing_state(Cpu *cpu) {
+    const HwThread *thread = &cpu->threads[0];
+    uint64_t h = FNV_OFFSET;
+
+    h = hash_int(h, thread->pc);
+    h = hash_int(h, thread->fetch_stopped);
+    h = hash_int(h, thread->rt.uprf_fl.len);
+    h = hash_int(h, thread->rt.ucrf_fl.len);
+    h = hash_int(h, cpu->commit_stall);
+
+    h = hash_stage(h, &cpu->fetch);
+    h = hash_stage(h, &cpu->decode_1);
+    h = hash_stage(h, &cpu->decode_2);
+
+    h = hash_station(h, cpu->irs.queue, &cpu->irs.tags[0][0], TAG_SLOTS(IRS_CAPACITY), cpu->irs.len);
+    h = hash_station(h, cpu->mrs.queue, &cpu->mrs.tags[0][0], TAG_SLOTS(MRS_CAPACITY), cpu->mrs.len);
+    h = hash_station(h, cpu->lsq.queue, &cpu->lsq.tags[0][0], TAG_SLOTS(LSQ_CAPACITY), cpu->lsq.len);
+
+    h = hash_fu(h, &cpu->intFU);
+    h = hash_fu(h, &cpu->mulFU);
+    h = hash_fu(h, &cpu->memFU);
+
+    h = hash_int(h, cpu->rob.part[0].len);
+    for (int i = 0; i < cpu->rob.part[0].len; i++) {
+        const IQE *iqe = rob_entry(&cpu->rob, 0, i);
+        h = hash_int(h, iqe->pc);
+        h = hash_int(h, iqe->completed);
+    }
+
+    return h;
+}
+
+void extrapolate_init(Extrapolator *ex, Cpu *cpu) {
+    assert(cpu->num_threads == 1 && cpu->mc == NULL && "Extrapolation needs a single-threaded core.");
+
+    memset(ex, 0, sizeof(*ex));
+    ex->cpu = cpu;
+    memcpy(ex->memory, cpu->memory, sizeof(ex->memory));
+    ex->emu = emu_new(&cpu->threads[0].code, ex->memory);
+    ex->branch_pc = -1;
+    ex->path = FNV_OFFSET;
+}
+
+// Period in iterations of the last back-edges, 0 if they don't repeat.
+// Every back-edge of the last two periods has to match the one a period
+// earlier, and both periods must take as many cycles and instructions.
+static int find_period(const Extrapolator *ex) {
+    const BackEdge *h = ex->history;
+    int last = ex->history_len - 1;
+
+    for (int p = 1; p <= EXTRAP_MAX_PERIOD && 2 * p <= last; p++) {
+        bool same = true;
+        for (int x = last - p; x <= last && same; x++) {
+            same = h[x].state == h[x - p].state && h[x].path == h[x - p].path;
+        }
+
+        if (same
+            && h[last].cycles - h[last - p].cycles == h[last - p].cycles - h[last - 2 * p].cycles
+            && h[last].committed - h[last - p].committed == h[last - p].committed - h[last - 2 * p].committed) {
+            return p;
+        }
+    }
+
+    return 0;
+}
+
+// Whole periods left in the loop that follow the same path, looking ahead
+// on a copy of the emulator
+static long count_periods_left(Extrapolator *ex, int p, int period_instructions) {
+    const BackEdge *h = ex->history;
+    int first = ex->history_len - p;
+
+    Emulator scout = ex->emu;
+    scout.memory = ex->scout_memory;
+    memcpy(ex->scout_memory, ex->memory, sizeof(ex->scout_memory));
+
+    long iterations = 0;
+    uint64_t path = FNV_OFFSET;
+    int steps = 0;
+
+    while (!scout.halted && steps <= period_instructions) {
+        EmuStep step = emu_step(&scout);
+        path = hash_int(path, step.pc);
+        steps += 1;
+
+        if (!emu_is_back_edge(step))
+            continue;
+
+        if (step.pc != ex->branch_pc || path != h[first + iterations % p].path)
+            break;
+
+        iterations += 1;
+        path = FNV_OFFSET;
+        steps = 0;
+    }
+
+    return iterations / p;
+}
+
+static void extrapolate_loop(Extrapolator *ex, int p) {
+    Cpu *cpu = ex->cpu;
+    const BackEdge *last = &ex->history[ex->history_len - 1];
+    const BackEdge *before = &ex->history[ex->history_len - 1 - p];
+    int period_cycles = last->cycles - before->cycles;
+    int period_instructions = last->committed - before->committed;
+
+    // The last period runs on the core to measure the restart
+    long skip = count_periods_left(ex, p, period_instructions) - 1;
+
+    // Cycle and instruction counters are ints
+    long room = (INT_MAX / 2 - cpu->cycles) / (period_cycles > period_instructions ? period_cycles : period_instructions);
+    if (skip > room) skip = room;
+
+    if (skip < 1) {
+        // Needs a whole new history before looking ahead again
+        ex->history_len = 0;
+        return;
+    }
+
+    long instructions = skip * period_instructions;
+    for (long i = 0; i < instructions; i++) {
+        emu_step(&ex->emu);
+    }
+
+    DBG("INFO", "Extrapolating %ld iterations of the loop at %d", skip * p, ex->branch_pc);
+
+    cpu->cycles += skip * period_cycles;
+    load_emulator_state(cpu, &ex->emu);
+
+    ex->loops += 1;
+    ex->skipped_iterations += skip * p;
+    ex->skipped_instructions += instructions;
+    ex->skipped_cycles += skip * period_cycles;
+
+    ex->measure_left = p;
+    ex->measure_start = cpu->cycles;
+    ex->measure_expected = period_cycles;
+    ex->history_len = 0;
+}
+
+static void on_back_edge(Extrapolator *ex, int pc) {
+    Cpu *cpu = ex->cpu;
+
+    if (pc != ex->branch_pc) {
+        ex->branch_pc = pc;
+        ex->history_len = 0;
+        ex->measure_left = 0;
+    }
+
+    if (ex->measure_left > 0) {
+        ex->measure_left -= 1;
+        if (ex->measure_left == 0) {
+            ex->restart_penalty += cpu->cycles - ex->measure_start - ex->measure_expected;
+        }
+    }
+
+    if (ex->history_len == EXTRAP_HISTORY) {
+        memmove(&ex->history[0], &ex->history[1], sizeof(BackEdge) * (EXTRAP_HISTORY - 1));
+        ex->history_len -= 1;
+    }
+
+    ex->history[ex->history_len] = (BackEdge){
+        .state = hash_timing_state(cpu),
+        .path = ex->path,
+        .cycles = cpu->cycles,
+        .committed = cpu->committed,
+    };
+    ex->history_len += 1;
+    ex->path = FNV_OFFSET;
+
+    if (ex->measure_left > 0)
+        return;
+
+    int p = find_period(ex);
+    if (p > 0) {
+        extrapolate_loop(ex, p);
+    }
+}
+
+bool extrapolate_cycle(Extrapolator *ex) {
+    Cpu *cpu = ex->cpu;
+    bool done = simulate_cycle(cpu);
+
+    // The emulator follows every commit of the core
+    while (ex->emu.executed < (size_t)cpu->committed) {
+        EmuStep step = emu_step(&ex->emu);
+        ex->path = hash_int(ex->path, step.pc);
+
+        if (emu_is_back_edge(step)) {
+            on_back_edge(ex, step.pc);
+        }
+    }
+
+    if (done && !ex->emu.halted) {
+        printf("Extrapolation: the emulator did not halt with the core at cycle %d\n", cpu->cycles);
+    }
+
+    return done;
+}
+
+int extrapolated_cycles(const Extrapolator *ex) {
+    return ex->cpu->cycles - ex->restart_penalty;
+}
+
+void print_extrapolation_stats(const Extrapolator *ex) {
+    const Cpu *cpu = ex->cpu;
+    int bound = abs(ex->restart_penalty);
+
+    printf("Extrapolation: loops=%d skipped_iterations=%ld skipped_instructions=%ld skipped_cycles=%ld\n",
+           ex->loops, ex->skipped_iterations, ex->skipped_instructions, ex->skipped_cycles);
+    printf("    Cycles: simulated=%d restart_penalty=%d estimate=%d (+/- %d)\n",
+           cpu->cycles, ex->restart_penalty, extrapolated_cycles(ex), bound);
+    printf("    Committed=%d, %.1f%% of them emulated\n", cpu->committed,
+           cpu->committed ? 100.0 * ex->skipped_instructions / cpu->committed : 0.0);
+}
+
+// Registers through the final mapping, and data memory
+static bool same_architectural_state(const Cpu *a, const Cpu *b) {
+    for (int r = 0; r < ARCH_REGS_COUNT; r++) {
+        if (a->uprf[a->threads[0].rt.table[r]] != b->uprf[b->threads[0].rt.table[r]])
+            return false;
+    }
+
+    return memcmp(a->memory, b->memory, sizeof(a->memory)) == 0;
+}
+
+void print_extrapolation_error(const Extrapolator *ex, const Cpu *full) {
+    int estimate = extrapolated_cycles(ex);
+    int error = estimate - full->cycles;
+
+    printf("    Full simulation: cycles=%d error=%+d (%.2f%%, bound +/- %d) committed=%s state=%s\n",
+           full->cycles, error, full->cycles ? 100.0 * error / full->cycles : 0.0, abs(ex->restart_penalty),
+           full->committed == ex->cpu->committed ? "same" : "DIFFERENT",
+           same_architectural_state(ex->cpu, full) ? "same" : "DIFFERENT");
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "emulator.h"
+
+#define EXTRAP_HISTORY (2 * EXTRAP_MAX_PERIOD + 1)
+
+// Core state seen when a loop back-edge committed
+typedef struct {
+    uint64_t state;     // Hash of latches, station/ROB occupancy and FU timing, no values
+    uint64_t path;      // Hash of the pcs committed since the previous back-edge
+    int cycles;
+    int committed;
+} BackEdge;
+
+// Memoised steady-state loop extrapolation of a single-threaded core.
+//
+// An emulator commits alongside the core. When the core state at a loop's
+// back-edge repeats with the same period in iterations and cycles, the loop
+// is in a steady state: the emulator runs the remaining iterations that
+// follow the same path, and the core restarts from its architectural state
+// with their cycles added. The last period is left to the core to measure
+// what restarting with an empty pipeline costs.
+typedef struct {
+    Cpu *cpu;
+    Emulator emu;
+    int memory[DATA_MEMORY_SIZE];       // Memory of the emulator
+    int scout_memory[DATA_MEMORY_SIZE]; // Copy used to look ahead
+
+    int branch_pc;                      // Back-edge of the loop tracked, -1 if none
+    BackEdge history[EXTRAP_HISTORY];
+    int history_len;
+    uint64_t path;                      // Path hash of the current iteration
+
+    int measure_left;                   // Back-edges until the restart is measured
+    int measure_start;                  // Cycle the core restarted at
+    int measure_expected;               // Cycles of a steady-state period
+
+    int loops;                          // Steady states extrapolated
+    long skipped_iterations;
+    long skipped_instructions;
+    long skipped_cycles;
+    int restart_penalty;                // Cycles lost to restarting with an empty pipeline
+} Extrapolator;
+
+// `cpu` must run one thread on its own and have its memory loaded
+void extrapolate_init(Extrapolator *ex, Cpu *cpu);
+
+// Simulates one cycle, extrapolating when a loop reaches a steady state.
+// Returns `true` once the program halted.
+bool extrapolate_cycle(Extrapolator *ex);
+
+// Cycles of the whole program, with the restarts taken out
+int extrapolated_cycles(const Extrapolator *ex);
+
+void print_extrapolation_stats(const Extrapolator *ex);
+
+// Compares the estimate and the final state against a full simulation
+void print_extrapolation_error(const Extrapolator *ex, const Cpu *full);
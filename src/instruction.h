@@ -1,15 +1,16 @@
 #pragma once
 
 #include <stddef.h>
-#include "bis.h"
+
+#include "arena.h"
+
+typedef struct StaticInfo StaticInfo;   // See analysis.h
 
 typedef struct
 {
     int pc;         // Program Counter
     int next_pc;    // Next Program Counter 
     
-    BisEntry bis_entry; // BIS information
-    
     int op;     // Opcode of the instruction
     int rd;     // Destination Register
     int rs1;    // Source Register 1
@@ -17,6 +18,15 @@ typedef struct
     int rs3;    // Source Register 3
     int imm;    // Immediate Value
     int cc;     // cc used by this inst
+    int prev_rd;    // Mapping of rd before this inst, freed at commit
+    int prev_cc;    // Mapping of cc before this inst, -1 if it does not write cc
+    int arch_rd;    // Architectural rd, set at rename
+    int idiom;      // IDIOM_* rename finishes this inst with, IDIOM_NONE if it executes
+    int fused_op;   // Conditional branch fused behind this inst at pc + 4, -1 if none
+    int fused_imm;  // ... and its offset
+    int thread; // Hardware thread this inst belongs to
+    long trace_index;   // Replayed trace record of this inst, -1 on the wrong path
+    const StaticInfo *info; // Load-time analysis of this inst
 } Instruction;
 
 typedef struct
@@ -25,7 +35,12 @@ typedef struct
     Instruction *data;
 } InstructionList;
 
-InstructionList parse(char *file_name);
+// Parses an assembly file, the instructions are allocated from `arena`.
+// Large files are split at line boundaries and parsed on several host threads.
+InstructionList parse(char *file_name, Arena *arena);
+
+// parse() on `threads` host threads, 0 picks a count for the file's size
+InstructionList parse_threads(char *file_name, Arena *arena, int threads);
 char *get_op_name(int opcode);
 void print_instruction(Instruction i);
 
@@ -0,0 +1,126 @@
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "livestats.h"
+
+static void object_name(char *dest, size_t size, const char *name) {
+    snprintf(dest, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void live_open(LivePublisher *pub, const char *name, int interval) {
+    *pub = (LivePublisher){ .interval = interval, .last_ns = now_ns() };
+    object_name(pub->name, sizeof(pub->name), name);
+
+    int fd = shm_open(pub->name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(LiveStats)) != 0) {
+        printf("Failed to create shared memory object %s.\n", pub->name);
+        exit(1);
+    }
+
+    pub->block = mmap(NULL, sizeof(LiveStats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pub->block == MAP_FAILED) {
+        printf("Failed to map shared memory object %s.\n", pub->name);
+        exit(1);
+    }
+
+    // An object left by an earlier run is reused from a clean, even state
+    memset(pub->block, 0, sizeof(LiveStats));
+    pub->block->magic = LIVE_STATS_MAGIC;
+    pub->block->version = LIVE_STATS_VERSION;
+    pub->block->pid = getpid();
+}
+
+long live_publish(LivePublisher *pub, const Sample *now) {
+    LiveStats *b = pub->block;
+    double ns = now_ns();
+    long cycles = now->cycle - pub->last.cycle;
+
+    uint32_t seq = atomic_load_explicit(&b->seq, memory_order_relaxed);
+    atomic_store_explicit(&b->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    b->cycle = now->cycle;
+    b->committed = now->committed;
+    b->ipc = now->cycle ? (double)now->committed / now->cycle : 0.0;
+    if (cycles > 0) {
+        b->recent_ipc = (double)(now->committed - pub->last.committed) / cycles;
+        b->host_cycles_per_sec = ns > pub->last_ns ? cycles / ((ns - pub->last_ns) * 1e-9) : 0.0;
+    }
+    b->irs = now->irs;
+    b->mrs = now->mrs;
+    b->lsq = now->lsq;
+    b->rob = now->rob;
+
+    atomic_store_explicit(&b->seq, seq + 2, memory_order_release);
+
+    pub->last = *now;
+    pub->last_ns = ns;
+
+    return now->cycle + pub->interval;
+}
+
+void live_close(LivePublisher *pub) {
+    LiveStats *b = pub->block;
+
+    uint32_t seq = atomic_load_explicit(&b->seq, memory_order_relaxed);
+    atomic_store_explicit(&b->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    b->done = 1;
+    atomic_store_explicit(&b->seq, seq + 2, memory_order_release);
+
+    munmap(b, sizeof(LiveStats));
+    shm_unlink(pub->name);
+    pub->block = NULL;
+}
+
+const LiveStats *live_attach(const char *name) {
+    char path[64];
+    object_name(path, sizeof(path), name);
+
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+
+    const LiveStats *b = mmap(NULL, sizeof(LiveStats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (b == MAP_FAILED)
+        return NULL;
+
+    if (b->magic != LIVE_STATS_MAGIC || b->version != LIVE_STATS_VERSION) {
+        munmap((void *)b, sizeof(LiveStats));
+        return NULL;
+    }
+
+    return b;
+}
+
+void live_read(const LiveStats *block, LiveStats *copy) {
+    LiveStats *b = (LiveStats *)block;
+
+    for (;;) {
+        uint32_t before = atomic_load_explicit(&b->seq, memory_order_acquire);
+        if (before % 2) {
+            sched_yield();
+            continue;
+        }
+
+        memcpy(copy, block, sizeof(LiveStats));
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&b->seq, memory_order_relaxed) == before)
+            return;
+    }
+}
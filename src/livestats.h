@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "timeseries.h"
+
+#define LIVE_STATS_MAGIC   0x41504558u  // "APEX"
+#define LIVE_STATS_VERSION 1            // Bumped whenever the layout changes
+
+// Block a running simulator publishes in a POSIX shared-memory object.
+// Writes are guarded by a seqlock: `seq` is odd while the block is being
+// written, readers retry until they copy it between two equal even values.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    _Atomic uint32_t seq;
+    int32_t pid;                        // Simulator process
+
+    int64_t cycle;
+    int64_t committed;
+    double ipc;                         // Over the whole run
+    double recent_ipc;                  // Since the previous update
+    int32_t irs, mrs, lsq, rob;         // Entries in use
+    double host_cycles_per_sec;         // Simulated cycles per host second, since the previous update
+    int32_t done;                       // The simulation ended, nothing more will be written
+} LiveStats;
+
+// Writer side, owned by the simulator
+typedef struct {
+    LiveStats *block;
+    char name[64];
+    int interval;                       // Cycles between updates
+    Sample last;                        // Counters at the previous update
+    double last_ns;                     // Host time of the previous update
+} LivePublisher;
+
+// Creates the shared-memory object `name` (a leading '/' is added if
+// missing) and maps the block. Exits if it cannot be created.
+void live_open(LivePublisher *pub, const char *name, int interval);
+
+// Publishes `now`. Returns the cycle of the next update.
+long live_publish(LivePublisher *pub, const Sample *now);
+
+// Marks the block done and removes the name, readers that mapped it keep
+// the final values
+void live_close(LivePublisher *pub);
+
+// Reader side: maps `name` read-only. Returns NULL if it does not exist or
+// is not a block of this version.
+const LiveStats *live_attach(const char *name);
+
+// Consistent copy of the block
+void live_read(const LiveStats *block, LiveStats *copy);
@@ -2,6 +2,10 @@
 
 #include <stdio.h>
 
-#define DEBUG 1
+// Runtime switch for the per-cycle debug output (defined in main.c).
+// Batch modes turn it off so worker threads don't flood stdout.
+extern int debug_enabled;
 
-#define DBG(tag, fmt, ...) if (DEBUG) { printf("%s : " fmt "\n", tag, __VA_ARGS__); }
\ No newline at end of file
+#define DEBUG debug_enabled
+
+#define DBG(tag, fmt, ...) if (DEBUG) { printf("%s : " fmt "\n", tag, __VA_ARGS__); }
@@ -3,8 +3,10 @@
 */
 #include <stdio.h>
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "instruction.h"
 #include "cpu.h"
@@ -12,8 +14,17 @@
 #include "rename.h"
 #include "commands.h"
 #include "util.h"
+#include "multicore.h"
+#include "extrapolate.h"
+#include "sample.h"
+#include "simpoint.h"
+#include "parallel.h"
+#include "stackdist.h"
+#include "trace.h"
 #define TRUE 1 
 
+int debug_enabled = 1;
+
 int get_command(char *input)
 {
     char *token = strtok(input, " ");
@@ -35,16 +46,27 @@ int get_command(char *input)
         return SET_MEM;
     } else if (strcmp(token, STR_QUIT) == 0) {
         return QUIT;
+    } else if (strcmp(token, STR_RUN) == 0) {
+        return RUN;
+    } else if (strcmp(token, STR_STATS) == 0) {
+        return STATS;
     }
 
     return -1;
 }
 
+// APEX_LIVE=<name> publishes the stats of the REPL's cpu to shared memory
 void repl(char *code_file)
 {
-    Cpu cpu;
+    static Cpu cpu;
     int is_done = 0;
 
+    static LivePublisher live;
+    char *live_name = getenv("APEX_LIVE");
+    if (live_name != NULL) {
+        live_open(&live, live_name, LIVE_STATS_INTERVAL);
+    }
+
     while (TRUE) {
         char line[100];
         printf("\nEnter command: ");
@@ -62,7 +84,11 @@ void repl(char *code_file)
         {
         case INITIALIZE: {
                 is_done = 0;
+                free_cpu(&cpu);
                 cpu = initialize_cpu(code_file);
+                if (live_name != NULL) {
+                    start_live_stats(&cpu, &live);
+                }
             }
             break;
         case SINGLE_STEP:
@@ -98,6 +124,21 @@ void repl(char *code_file)
                 }
             }
             break;
+        case RUN: {
+                if (is_done) {
+                    printf("Simulation completed. 'Initialize' again to restart. Or enter 'q' to Quit.\n");
+                    break;
+                }
+
+                while (!is_done) {
+                    is_done = simulate_cycle(&cpu);
+                }
+                printf("Simulated to HALT at cycle %d.\n", cpu.cycles);
+            }
+            break;
+        case STATS:
+            print_smt_stats(&cpu);
+            break;
         case DISPLAY:
             display(&cpu);
             break;
@@ -134,24 +175,974 @@ void repl(char *code_file)
         }
     }
 done:
+    if (live_name != NULL) {
+        live_close(&live);
+    }
+    free_cpu(&cpu);
     printf("Simulation completed...\n");
     return;
 }
 
+static bool parse_drain_policy(const char *name, int *policy) {
+    if (strcmp(name, "eager") == 0) {
+        *policy = SB_DRAIN_EAGER;
+    } else if (strcmp(name, "lazy") == 0) {
+        *policy = SB_DRAIN_LAZY;
+    } else {
+        printf("Unknown drain policy `%s`, expected `eager` or `lazy`.\n", name);
+        return false;
+    }
+
+    return true;
+}
+
+// --energy, --energy-costs <file> and --freq <MHz>. Returns false if argv[*i]
+// is none of them; the options after --energy only matter with it.
+static bool parse_energy_option(int argc, char **argv, int *i, EnergyModel *model, bool *enabled) {
+    if (strcmp(argv[*i], "--energy") == 0) {
+        *enabled = true;
+    } else if (strcmp(argv[*i], "--energy-costs") == 0 && *i + 1 < argc) {
+        energy_load(model, argv[++*i]);
+        *enabled = true;
+    } else if (strcmp(argv[*i], "--freq") == 0 && *i + 1 < argc) {
+        model->freq_mhz = atof(argv[++*i]);
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+// Whole non-negative number, false for anything else (`abc`, `12x`, `-1`)
+static bool parse_count(const char *arg, long *value) {
+    if (arg == NULL)
+        return false;
+
+    char *end;
+    errno = 0;
+    *value = strtol(arg, &end, 10);
+
+    return end != arg && *end == '\0' && errno == 0 && *value >= 0;
+}
+
+// Batch form of the REPL commands for automation. Each command prints one
+// result line, `ok <command> key=value ...` or `error <command> <reason>`;
+// Display prints the pipeline dump before its result line. Blank lines and
+// lines starting with `#` are skipped. Exits with 1 if a command failed.
+//
+//      Initialize | Single_step | Simulate <n> | Run [<max_cycles>] | Stats
+//      SetMem <file> | ShowMem <address> | Display | q
+//
+// ./cpu --script <file|-> <asm_file>
+int script_main(int argc, char **argv)
+{
+    if (argc != 2) {
+        printf("Usage: ./cpu --script <file|-> <asm_file>\n");
+        return 1;
+    }
+
+    FILE *in = strcmp(argv[0], "-") == 0 ? stdin : fopen(argv[0], "r");
+    if (in == NULL) {
+        printf("Failed to open file %s.\n", argv[0]);
+        return 1;
+    }
+
+    debug_enabled = getenv("APEX_DEBUG") != NULL;
+
+    static Cpu cpu;
+    bool initialized = false;
+    bool is_done = false;
+    bool failed = false;
+
+    char *line = NULL;
+    size_t cap = 0;
+
+    while (getline(&line, &cap, in) != -1) {
+        trim(line);
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        char name[32];
+        snprintf(name, sizeof(name), "%s", line);
+        strtok(name, " ");
+
+        int cmd = get_command(line);
+        char *arg = strtok(NULL, " ");
+
+        if (cmd == -1) {
+            printf("error %s unknown command\n", name);
+            failed = true;
+            continue;
+        }
+        if (cmd == QUIT)
+            break;
+
+        if (cmd != INITIALIZE && !initialized) {
+            printf("error %s not initialized\n", name);
+            failed = true;
+            continue;
+        }
+
+        switch (cmd) {
+        case INITIALIZE:
+            if (initialized) {
+                free_cpu(&cpu);
+            }
+            cpu = initialize_cpu(argv[1]);
+            initialized = true;
+            is_done = false;
+            printf("ok %s\n", name);
+            break;
+        case SINGLE_STEP:
+        case SIMULATE:
+        case RUN: {
+                long limit = cmd == SINGLE_STEP ? 1 : -1;
+                if (cmd == SIMULATE || (cmd == RUN && arg != NULL)) {
+                    if (!parse_count(arg, &limit)) {
+                        printf("error %s expected a cycle count\n", name);
+                        failed = true;
+                        break;
+                    }
+                }
+
+                int start = cpu.cycles;
+                for (long n = 0; !is_done && n != limit; n++) {
+                    is_done = simulate_cycle(&cpu);
+                }
+
+                printf("ok %s ran=%d cycles=%d committed=%d halted=%d\n",
+                       name, cpu.cycles - start, cpu.cycles, cpu.committed, is_done);
+            }
+            break;
+        case STATS:
+            printf("ok %s cycles=%d committed=%d ipc=%.3f halted=%d rename_stalls=%d fetch_queue_full=%d"
+                   " decode_starved=%d flushes=%d\n",
+                   name, cpu.cycles, cpu.committed, cpu.cycles ? (double)cpu.committed / cpu.cycles : 0.0, is_done,
+                   cpu.stats.rename_stall_cycles, cpu.stats.fetch_queue_full, cpu.stats.decode_starved,
+                   cpu.stats.flushes);
+            break;
+        case DISPLAY:
+            display(&cpu);
+            printf("ok %s\n", name);
+            break;
+        case SHOW_MEM: {
+                long address;
+                if (!parse_count(arg, &address) || address >= DATA_MEMORY_SIZE) {
+                    printf("error %s expected an address between 0 and %d\n", name, DATA_MEMORY_SIZE - 1);
+                    failed = true;
+                    break;
+                }
+                printf("ok %s address=%ld value=%d\n", name, address, cpu.memory[address]);
+            }
+            break;
+        case SET_MEM:
+            if (arg == NULL || access(arg, R_OK) != 0) {
+                printf("error %s cannot read `%s`\n", name, arg != NULL ? arg : "");
+                failed = true;
+                break;
+            }
+            set_memory(&cpu, arg);
+            printf("ok %s\n", name);
+            break;
+        }
+    }
+
+    free(line);
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (initialized) {
+        free_cpu(&cpu);
+    }
+
+    return failed;
+}
+
+// ./cpu --multicore [--quantum <n>] [--store-buffer <n>] [--drain eager|lazy]
+//                   [--energy] [--energy-costs <file>] [--freq <MHz>] [--mem <file>] <asm_file> [<asm_file> ...]
+int multicore_main(int argc, char **argv)
+{
+    int quantum = MULTICORE_QUANTUM;
+    int store_buffer = STORE_BUFFER_DEPTH;
+    int drain = SB_DRAIN_EAGER;
+    static EnergyModel energy;
+    energy = energy_default();
+    bool report_energy = false;
+    char *mem_file = NULL;
+    int i = 0;
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--quantum") == 0 && i + 1 < argc) {
+            quantum = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--store-buffer") == 0 && i + 1 < argc) {
+            store_buffer = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--drain") == 0 && i + 1 < argc) {
+            if (!parse_drain_policy(argv[++i], &drain))
+                return 1;
+        } else if (parse_energy_option(argc, argv, &i, &energy, &report_energy)) {
+            continue;
+        } else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_file = argv[++i];
+        } else {
+            break;
+        }
+    }
+
+    if (i == argc || store_buffer < 0 || store_buffer > STORE_BUFFER_MAX || energy.freq_mhz <= 0) {
+        printf("Usage: ./cpu --multicore [--quantum <n>] [--store-buffer <0-%d>] [--drain eager|lazy]\n"
+               "                         [--energy] [--energy-costs <file>] [--freq <MHz>] [--mem <file>]\n"
+               "                         <asm_file> [<asm_file> ...]\n", STORE_BUFFER_MAX);
+        return 1;
+    }
+
+    debug_enabled = getenv("APEX_DEBUG") != NULL;
+
+    static MultiCore mc;
+    if (!initialize_multicore(&mc, argv + i, argc - i, quantum)) {
+        return 1;
+    }
+    for (int c = 0; c < mc.num_cores; c++) {
+        sb_init(&mc.cores[c].store_buffer, store_buffer, drain);
+        mc.cores[c].energy_model = report_energy ? &energy : NULL;
+    }
+    if (mem_file != NULL) {
+        multicore_set_memory(&mc, mem_file);
+    }
+
+    multicore_run(&mc);
+    print_multicore_stats(&mc);
+    multicore_free(&mc);
+
+    return 0;
+}
+
+// ./cpu --smt [--fetch-policy rr|icount] [--fetch-queue <n>] [--memdep ideal|blind|storesets]
+//             [--mshrs <n>] [--eliminate] [--fuse] [--store-buffer <n>] [--drain eager|lazy]
+//             [--energy] [--energy-costs <file>] [--freq <MHz>] [--series <file> [--series-interval <n>]]
+//             [--live <name>] [--mem <file>] <asm_file> [<asm_file> ...]
+int smt_main(int argc, char **argv)
+{
+    int fetch_policy = FETCH_ROUND_ROBIN;
+    int fetch_queue = FETCH_QUEUE_DEPTH;
+    int memdep_mode = MEMDEP_IDEAL;
+    int mshrs = MSHR_COUNT;
+    bool eliminate = RENAME_ELIMINATION;
+    bool fuse = MACRO_FUSION;
+    int store_buffer = STORE_BUFFER_DEPTH;
+    int drain = SB_DRAIN_EAGER;
+    static EnergyModel energy;
+    energy = energy_default();
+    bool report_energy = false;
+    char *series_file = NULL;
+    int series_interval = TIME_SERIES_INTERVAL;
+    char *live_name = NULL;
+    char *mem_file = NULL;
+    int i = 0;
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--fetch-policy") == 0 && i + 1 < argc) {
+            i += 1;
+            if (strcmp(argv[i], "icount") == 0) {
+                fetch_policy = FETCH_ICOUNT;
+            } else if (strcmp(argv[i], "rr") == 0) {
+                fetch_policy = FETCH_ROUND_ROBIN;
+            } else {
+                printf("Unknown fetch policy `%s`, expected `rr` or `icount`.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--fetch-queue") == 0 && i + 1 < argc) {
+            fetch_queue = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--memdep") == 0 && i + 1 < argc) {
+            i += 1;
+            if (strcmp(argv[i], "ideal") == 0) {
+                memdep_mode = MEMDEP_IDEAL;
+            } else if (strcmp(argv[i], "blind") == 0) {
+                memdep_mode = MEMDEP_BLIND;
+            } else if (strcmp(argv[i], "storesets") == 0) {
+                memdep_mode = MEMDEP_STORE_SETS;
+            } else {
+                printf("Unknown memory dependence mode `%s`, expected `ideal`, `blind` or `storesets`.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--mshrs") == 0 && i + 1 < argc) {
+            mshrs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--eliminate") == 0) {
+            eliminate = true;
+        } else if (strcmp(argv[i], "--fuse") == 0) {
+            fuse = true;
+        } else if (strcmp(argv[i], "--store-buffer") == 0 && i + 1 < argc) {
+            store_buffer = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--drain") == 0 && i + 1 < argc) {
+            if (!parse_drain_policy(argv[++i], &drain))
+                return 1;
+        } else if (parse_energy_option(argc, argv, &i, &energy, &report_energy)) {
+            continue;
+        } else if (strcmp(argv[i], "--series") == 0 && i + 1 < argc) {
+            series_file = argv[++i];
+        } else if (strcmp(argv[i], "--series-interval") == 0 && i + 1 < argc) {
+            series_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--live") == 0 && i + 1 < argc) {
+            live_name = argv[++i];
+        } else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_file = argv[++i];
+        } else {
+            break;
+        }
+    }
+
+    int num_threads = argc - i;
+    if (num_threads < 1 || num_threads > SMT_MAX_THREADS || fetch_queue < 0 || fetch_queue > FETCH_QUEUE_MAX
+        || mshrs < 0 || mshrs > MSHR_MAX || store_buffer < 0 || store_buffer > STORE_BUFFER_MAX || energy.freq_mhz <= 0
+        || series_interval < 1) {
+        printf("Usage: ./cpu --smt [--fetch-policy rr|icount] [--fetch-queue <0-%d>] [--memdep ideal|blind|storesets]\n"
+               "                   [--mshrs <0-%d>] [--eliminate] [--fuse]\n"
+               "                   [--store-buffer <0-%d>] [--drain eager|lazy] [--energy] [--energy-costs <file>] [--freq <MHz>]\n"
+               "                   [--series <file.csv|file.json> [--series-interval <n>]] [--live <name>]\n"
+               "                   [--mem <file>] <asm_file> [<asm_file> ...] (1 to %d files)\n",
+               FETCH_QUEUE_MAX, MSHR_MAX, STORE_BUFFER_MAX, SMT_MAX_THREADS);
+        return 1;
+    }
+
+    debug_enabled = getenv("APEX_DEBUG") != NULL;
+
+    static Cpu cpu;
+    cpu = initialize_smt_cpu(argv + i, num_threads, fetch_policy);
+    cpu.fetch_queue_depth = fetch_queue;
+    cpu.memdep_mode = memdep_mode;
+    cpu.rename_elimination = eliminate;
+    cpu.macro_fusion = fuse;
+    sb_init(&cpu.store_buffer, store_buffer, drain);
+    mshr_init(&cpu.mshrs, mshrs);
+    cpu.energy_model = report_energy ? &energy : NULL;
+    if (mem_file != NULL) {
+        set_memory(&cpu, mem_file);
+    }
+
+    TimeSeries series;
+    if (series_file != NULL) {
+        Sample *samples = arena_alloc(&cpu.arena, TIME_SERIES_SAMPLES * sizeof(Sample));
+        ts_init(&series, series_interval, samples, TIME_SERIES_SAMPLES);
+        start_time_series(&cpu, &series);
+    }
+
+    static LivePublisher live;
+    if (live_name != NULL) {
+        live_open(&live, live_name, LIVE_STATS_INTERVAL);
+        start_live_stats(&cpu, &live);
+    }
+
+    while (!simulate_cycle(&cpu));
+
+    if (live_name != NULL) {
+        publish_live_stats(&cpu);
+        live_close(&live);
+    }
+
+    if (series_file != NULL) {
+        record_sample(&cpu);
+
+        FILE *f = fopen(series_file, "w");
+        if (f == NULL) {
+            printf("Failed to open file %s.\n", series_file);
+            return 1;
+        }
+        size_t len = strlen(series_file);
+        ts_write(&series, f, len >= 5 && strcmp(series_file + len - 5, ".json") == 0);
+        fclose(f);
+    }
+
+    print_smt_stats(&cpu);
+    free_cpu(&cpu);
+
+    return 0;
+}
+
+// ./cpu --extrapolate [--check] [--mem <file>] <asm_file>
+int extrapolate_main(int argc, char **argv)
+{
+    bool check = false;
+    char *mem_file = NULL;
+    int i = 0;
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_file = argv[++i];
+        } else {
+            break;
+        }
+    }
+
+    if (argc - i != 1) {
+        printf("Usage: ./cpu --extrapolate [--check] [--mem <file>] <asm_file>\n");
+        return 1;
+    }
+
+    debug_enabled = getenv("APEX_DEBUG") != NULL;
+
+    static Cpu cpu;
+    static Extrapolator ex;
+    cpu = initialize_cpu(argv[i]);
+    if (mem_file != NULL) {
+        set_memory(&cpu, mem_file);
+    }
+
+    extrapolate_init(&ex, &cpu);
+    while (!extrapolate_cycle(&ex));
+
+    print_smt_stats(&cpu);
+    print_extrapolation_stats(&ex);
+
+    // Same program without extrapolation, to measure the error
+    if (check) {
+        static Cpu full;
+        full = initialize_cpu(argv[i]);
+        if (mem_file != NULL) {
+            set_memory(&full, mem_file);
+        }
+
+        while (!simulate_cycle(&full));
+
+        print_extrapolation_error(&ex, &full);
+        free_cpu(&full);
+    }
+
+    free_cpu(&cpu);
+
+    return 0;
+}
+
+// ./cpu --sample [--unit <n>] [--warmup <n>] [--interval <n>] [--target-error <%>]
+//               [--confidence 95|99|99.7] [--check] [--mem <file>] <asm_file>
+int sample_main(int argc, char **argv)
+{
+    SampleConfig config = {
+        .unit = SAMPLE_UNIT,
+        .warmup = SAMPLE_WARMUP,
+        .interval = SAMPLE_INTERVAL,
+        .target_error = SAMPLE_TARGET_ERROR,
+        .z = 3.0,
+    };
+    bool check = false;
+    char *mem_file = NULL;
+    int i = 0;
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--unit") == 0 && i + 1 < argc) {
+            config.unit = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            config.warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            config.interval = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--target-error") == 0 && i + 1 < argc) {
+            config.target_error = atof(argv[++i]) / 100.0;
+        } else if (strcmp(argv[i], "--confidence") == 0 && i + 1 < argc) {
+            // Only the levels with a known z are accepted, 0 fails the usage check
+            double confidence = atof(argv[++i]);
+            config.z = confidence == 99.7 ? 3.0 : confidence == 99 ? 2.576 : confidence == 95 ? 1.96 : 0;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_file = argv[++i];
+        } else {
+            break;
+        }
+    }
+
+    if (argc - i != 1 || config.unit < 1 || config.warmup < 0 || config.target_error <= 0
+        || config.z <= 0 || config.interval < config.unit + config.warmup) {
+        printf("Usage: ./cpu --sample [--unit <n>] [--warmup <n>] [--interval <n>] [--target-error <%%>]\n"
+               "                      [--confidence 95|99|99.7] [--check] [--mem <file>] <asm_file>\n"
+               "The interval has to hold the warm-up and the unit.\n");
+        return 1;
+    }
+
+    debug_enabled = getenv("APEX_DEBUG") != NULL;
+
+    static Cpu cpu;
+    static Sampler sampler;
+
+    // A second run with the interval the measured variation asks for
+    for (int run = 0; run < 2; run++) {
+        cpu = initialize_cpu(argv[i]);
+        if (mem_file != NULL) {
+            set_memory(&cpu, mem_file);
+        }
+
+        sample_run(&sampler, &cpu, config);
+        free_cpu(&cpu);
+
+        // Without a sample there is nothing to estimate from
+        if (sampler.samples > 0) {
+            print_sample_stats(&sampler);
+        }
+
+        // A program shorter than warm-up and unit has no interval to retry with
+        long interval = sample_recommended_interval(&sampler);
+        bool met = sample_error(&sampler) <= config.target_error;
+        if (met || run == 1 || interval >= config.interval
+            || sampler.instructions <= config.unit + config.warmup) {
+            if (!met && sampler.samples > 0) {
+                printf("Target error of %.2f%% not met sampling every %ld instructions\n",
+                       100.0 * config.target_error, config.interval);
+            }
+            break;
+        }
+
+        printf("%s, sampling again every %ld instructions\n",
+               sampler.samples > 0 ? "Target error missed" : "No sample fit in the program", interval);
+        config.interval = interval;
+    }
+
+    // The program is shorter than one sample: simulate it in full instead
+    static Cpu full;
+    bool simulated = sampler.samples == 0 || check;
+    if (simulated) {
+        full = initialize_cpu(argv[i]);
+        if (mem_file != NULL) {
+            set_memory(&full, mem_file);
+        }
+
+        while (!simulate_cycle(&full));
+    }
+
+    if (sampler.samples == 0) {
+        sample_set_exact(&sampler, &full);
+        print_sample_stats(&sampler);
+    }
+    if (check) {
+        print_sample_error(&sampler, &full);
+    }
+    if (simulated) {
+        free_cpu(&full);
+    }
+
+    return 0;
+}
+
+// ./cpu --simpoint [--interval <n>] [--warmup <n>] [--max-k <n>] [--bbv <file>]
+//                 [--check] [--mem <file>] <asm_file>
+int simpoint_main(int argc, char **argv)
+{
+    long interval = SIMPOINT_INTERVAL;
+    int warmup = SIMPOINT_WARMUP;
+    int max_k = SIMPOINT_MAX_K;
+    char *bbv_file = NULL;
+    bool check = false;
+    char *mem_file = NULL;
+    int i = 0;
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-k") == 0 && i + 1 < argc) {
+            max_k = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bbv") == 0 && i + 1 < argc) {
+            bbv_file = argv[++i];
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_file = argv[++i];
+        } else {
+            break;
+        }
+    }
+
+    if (argc - i != 1 || interval < 1 || warmup < 0 || max_k < 1 || max_k > SIMPOINT_MAX_K) {
+        printf("Usage: ./cpu --simpoint [--interval <n>] [--warmup <n>] [--max-k <1-%d>] [--bbv <file>]\n"
+               "                        [--check] [--mem <file>] <asm_file>\n", SIMPOINT_MAX_K);
+        return 1;
+    }
+
+    debug_enabled = getenv("APEX_DEBUG") != NULL;
+
+    static Cpu cpu;
+    static SimPoints sp;
+    static int memory[DATA_MEMORY_SIZE];
+
+    cpu = initialize_cpu(argv[i]);
+    if (mem_file != NULL) {
+        set_memory(&cpu, mem_file);
+    }
+    memcpy(memory, cpu.memory, sizeof(memory));
+
+    FILE *bbv = NULL;
+    if (bbv_file != NULL && (bbv = fopen(bbv_file, "w")) == NULL) {
+        printf("Failed to open file %s.\n", bbv_file);
+        return 1;
+    }
+
+    simpoint_profile(&sp, &cpu.threads[0].code, memory, interval, warmup, bbv);
+    if (bbv != NULL) {
+        fclose(bbv);
+    }
+
+    simpoint_cluster(&sp, max_k);
+    simpoint_simulate(&sp, &cpu, memory);
+    print_simpoints(&sp);
+
+    if (check) {
+        static Cpu full;
+        full = initialize_cpu(argv[i]);
+        memcpy(full.memory, memory, sizeof(memory));
+
+        while (!simulate_cycle(&full));
+
+        print_simpoint_error(&sp, &full);
+        free_cpu(&full);
+    }
+
+    simpoint_free(&sp);
+    free_cpu(&cpu);
+
+    return 0;
+}
+
+// ./cpu --parallel [--interval <n>] [--warmup <n>] [--jobs <n>] [--check] [--mem <file>] <asm_file>
+int parallel_main(int argc, char **argv)
+{
+    long interval = PARALLEL_INTERVAL;
+    int warmup = PARALLEL_WARMUP;
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    bool check = false;
+    char *mem_file = NULL;
+    int i = 0;
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_file = argv[++i];
+        } else {
+            break;
+        }
+    }
+
+    if (argc - i != 1 || interval < 1 || warmup < 0 || jobs < 1) {
+        printf("Usage: ./cpu --parallel [--interval <n>] [--warmup <n>] [--jobs <n>] [--check] [--mem <file>] <asm_file>\n");
+        return 1;
+    }
+
+    // Workers must not print their cycles
+    debug_enabled = 0;
+
+    static int memory[DATA_MEMORY_SIZE];
+    if (mem_file != NULL) {
+        read_memory_file(memory, mem_file);
+    }
+
+    static ParallelRun run;
+    parallel_checkpoint(&run, argv[i], memory, interval, warmup);
+    parallel_simulate(&run, jobs);
+    print_parallel_stats(&run);
+
+    if (check) {
+        static Cpu full;
+        full = initialize_cpu(argv[i]);
+        memcpy(full.memory, memory, sizeof(memory));
+
+        double start = wall_seconds();
+        while (!simulate_cycle(&full));
+
+        print_parallel_error(&run, &full, wall_seconds() - start);
+        free_cpu(&full);
+    }
+
+    parallel_free(&run);
+
+    return 0;
+}
+
+// ./cpu --record <trace> [--mem <file>] <asm_file>
+int record_main(int argc, char **argv)
+{
+    char *mem_file = NULL;
+    int i = 1;
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_file = argv[++i];
+        } else {
+            break;
+        }
+    }
+
+    if (argc < 1 || argc - i != 1) {
+        printf("Usage: ./cpu --record <trace> [--mem <file>] <asm_file>\n");
+        return 1;
+    }
+
+    static int memory[DATA_MEMORY_SIZE];
+    if (mem_file != NULL) {
+        read_memory_file(memory, mem_file);
+    }
+
+    Arena arena = arena_new(64 * 1024);
+    InstructionList code = parse(argv[i], &arena);
+
+    static TraceWriter tw;
+    trace_record(&tw, argv[0], &code, memory);
+    print_trace_stats(&tw);
+
+    arena_release(&arena);
+
+    return 0;
+}
+
+// ./cpu --replay <trace> [--check] [--mem <file>] <asm_file>
+int replay_main(int argc, char **argv)
+{
+    bool check = false;
+    char *mem_file = NULL;
+    int i = 1;
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_file = argv[++i];
+        } else {
+            break;
+        }
+    }
+
+    if (argc < 1 || argc - i != 1) {
+        printf("Usage: ./cpu --replay <trace> [--check] [--mem <file>] <asm_file>\n");
+        return 1;
+    }
+
+    debug_enabled = getenv("APEX_DEBUG") != NULL;
+
+    // The program only gives the registers of each instruction, the trace
+    // gives everything that depends on values
+    static Cpu cpu;
+    static TraceReader trace;
+    cpu = initialize_cpu(argv[i]);
+    trace_open(&trace, argv[0], &cpu.threads[0].code);
+    cpu.trace = &trace;
+
+    double start = wall_seconds();
+    while (!simulate_cycle(&cpu));
+    double seconds = wall_seconds() - start;
+
+    printf("Replay: cycles=%d instructions=%d IPC=%.3f wall=%.3fs\n", cpu.cycles, cpu.committed,
+           cpu.cycles ? (double)cpu.committed / cpu.cycles : 0.0, seconds);
+
+    if (check) {
+        static Cpu full;
+        full = initialize_cpu(argv[i]);
+        if (mem_file != NULL) {
+            set_memory(&full, mem_file);
+        }
+
+        start = wall_seconds();
+        while (!simulate_cycle(&full));
+        double full_seconds = wall_seconds() - start;
+
+        int error = cpu.cycles - full.cycles;
+        printf("    Full simulation: cycles=%d error=%+d (%.2f%%) wall=%.3fs speedup=%.2fx\n",
+               full.cycles, error, full.cycles ? 100.0 * error / full.cycles : 0.0,
+               full_seconds, seconds > 0 ? full_seconds / seconds : 0.0);
+        free_cpu(&full);
+    }
+
+    trace_close(&trace);
+    free_cpu(&cpu);
+
+    return 0;
+}
+
+// ./cpu --parse [--threads <n>] [--check] <asm_file>
+int parse_main(int argc, char **argv)
+{
+    int threads = 0;
+    bool check = false;
+    int i = 0;
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else {
+            break;
+        }
+    }
+
+    if (argc - i != 1 || threads < 0 || threads > PARSE_MAX_THREADS) {
+        printf("Usage: ./cpu --parse [--threads <0-%d>] [--check] <asm_file> (0 picks the thread count)\n",
+               PARSE_MAX_THREADS);
+        return 1;
+    }
+
+    Arena arena = arena_new(64 * 1024);
+
+    double start = wall_seconds();
+    InstructionList code = parse_threads(argv[i], &arena, threads);
+    double seconds = wall_seconds() - start;
+
+    printf("Parse: instructions=%zu seconds=%.3f\n", code.len, seconds);
+
+    if (check) {
+        start = wall_seconds();
+        InstructionList serial = parse_threads(argv[i], &arena, 1);
+        seconds = wall_seconds() - start;
+
+        size_t n = 0;
+        while (n < code.len && n < serial.len) {
+            const Instruction *a = &code.data[n], *b = &serial.data[n];
+            if (a->op != b->op || a->rd != b->rd || a->rs1 != b->rs1 || a->rs2 != b->rs2 || a->rs3 != b->rs3
+                || a->imm != b->imm)
+                break;
+            n += 1;
+        }
+
+        bool same = n == code.len && n == serial.len;
+        printf("Check: serial seconds=%.3f %s", seconds, same ? "identical\n" : "MISMATCH");
+        if (!same) {
+            printf(" at instruction %zu\n", n);
+        }
+        arena_release(&arena);
+        return !same;
+    }
+
+    arena_release(&arena);
+
+    return 0;
+}
+
+// ./cpu --analyze <asm_file>
+int analyze_main(int argc, char **argv)
+{
+    if (argc != 1) {
+        printf("Usage: ./cpu --analyze <asm_file>\n");
+        return 1;
+    }
+
+    Arena arena = arena_new(64 * 1024);
+    InstructionList code = parse(argv[0], &arena);
+
+    analyze_program(&code, &arena);
+    print_analysis(&code, stdout);
+
+    arena_release(&arena);
+
+    return 0;
+}
+
+// ./cpu --stackdist [--check] [--mem <file>] <asm_file>
+int stackdist_main(int argc, char **argv)
+{
+    bool check = false;
+    char *mem_file = NULL;
+    int i = 0;
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_file = argv[++i];
+        } else {
+            break;
+        }
+    }
+
+    if (argc - i != 1) {
+        printf("Usage: ./cpu --stackdist [--check] [--mem <file>] <asm_file>\n");
+        return 1;
+    }
+
+    debug_enabled = getenv("APEX_DEBUG") != NULL;
+
+    static Cpu cpu;
+    static StackProfiler sp;
+    static int memory[DATA_MEMORY_SIZE];
+
+    cpu = initialize_cpu(argv[i]);
+    if (mem_file != NULL) {
+        set_memory(&cpu, mem_file);
+    }
+    memcpy(memory, cpu.memory, sizeof(memory));
+
+    stackdist_init(&sp);
+    cpu.stack_profiler = &sp;
+    while (!simulate_cycle(&cpu));
+
+    printf("Simulation: cycles=%d instructions=%d\n", cpu.cycles, cpu.committed);
+    print_stackdist(&sp);
+
+    if (check) {
+        stackdist_check(&sp, &cpu.threads[0].code, memory);
+    }
+
+    free_cpu(&cpu);
+
+    return 0;
+}
+
 int main(int argc, char **argv) {
 
+    // Batch output stays free of anything but results
+    if (argc >= 2 && strcmp(argv[1], "--script") == 0) {
+        return script_main(argc - 2, argv + 2);
+    }
+
     printf("Hello, Apex Out of Order.\n\n");
 
+    if (argc >= 2 && strcmp(argv[1], "--multicore") == 0) {
+        return multicore_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--smt") == 0) {
+        return smt_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--extrapolate") == 0) {
+        return extrapolate_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--sample") == 0) {
+        return sample_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--simpoint") == 0) {
+        return simpoint_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--parallel") == 0) {
+        return parallel_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--record") == 0) {
+        return record_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--replay") == 0) {
+        return replay_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--parse") == 0) {
+        return parse_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--analyze") == 0) {
+        return analyze_main(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--stackdist") == 0) {
+        return stackdist_main(argc - 2, argv + 2);
+    }
+
     assert(argc == 2 && "Usage: ./cpu <asm_file>");
 
     Cpu cpu = initialize_cpu(argv[1]);
 
-    DBG("INFO", "Instructions parsed: %lu", cpu.code.len);
+    DBG("INFO", "Instructions parsed: %lu", cpu.threads[0].code.len);
 
     //while (!simulate_cycle(&cpu));
     // for (int i = 0; i < 2; i++) simulate_cycle(&cpu);
     repl(argv[1]);
     printf("Current simulation lasted for %d cycles.\n", cpu.cycles);
+    free_cpu(&cpu);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "instruction.h"
+#include "memdep.h"
+
+void memdep_init(StoreSets *ss) {
+    memset(ss, 0, sizeof(*ss));
+    memset(ss->ssit, -1, sizeof(ss->ssit));
+    ss->until_clear = MEMDEP_CLEAR_INTERVAL;
+}
+
+bool is_load(int op) {
+    return op == OP_LOAD || op == OP_LDR;
+}
+
+bool is_store(int op) {
+    return op == OP_STORE || op == OP_STR;
+}
+
+// Threads run different programs, so their pcs must not share entries
+static int *ssit_entry(StoreSets *ss, int pc, int thread) {
+    unsigned index = (unsigned)(pc / 4) ^ (unsigned)thread * 0x9e3779b1u;
+    return &ss->ssit[index % MEMDEP_SSIT_SIZE];
+}
+
+IQE *memdep_dispatch(StoreSets *ss, IQE *iqe) {
+    if (--ss->until_clear == 0) {
+        memset(ss->ssit, -1, sizeof(ss->ssit));
+        ss->until_clear = MEMDEP_CLEAR_INTERVAL;
+    }
+
+    int set = *ssit_entry(ss, iqe->pc, iqe->thread);
+    if (set == -1)
+        return NULL;
+
+    LfstEntry *last = &ss->lfst[set];
+    IQE *wait = last->store;
+
+    if (is_load(iqe->op) && wait != NULL) {
+        ss->delayed += 1;
+    }
+
+    // Stores of a set also go in order, so a load waits for the last one only
+    if (is_store(iqe->op)) {
+        *last = (LfstEntry){ .store = iqe, .seq = iqe->seq };
+    }
+
+    return wait;
+}
+
+void memdep_store_resolved(StoreSets *ss, IQE *store) {
+    for (int s = 0; s < MEMDEP_LFST_SIZE; s++) {
+        if (ss->lfst[s].store == store && ss->lfst[s].seq == store->seq)
+            ss->lfst[s].store = NULL;
+    }
+}
+
+void memdep_train(StoreSets *ss, const IQE *store, const IQE *load) {
+    int *store_set = ssit_entry(ss, store->pc, store->thread);
+    int *load_set = ssit_entry(ss, load->pc, load->thread);
+
+    if (*store_set == -1 && *load_set == -1) {
+        *store_set = *load_set = ss->next_set;
+        ss->next_set = (ss->next_set + 1) % MEMDEP_LFST_SIZE;
+    } else if (*store_set == -1) {
+        *store_set = *load_set;
+    } else if (*load_set == -1) {
+        *load_set = *store_set;
+    } else if (*store_set < *load_set) {
+        *load_set = *store_set;
+    } else {
+        *store_set = *load_set;
+    }
+}
+
+void memdep_flush(StoreSets *ss, int thread, uint64_t seq) {
+    for (int s = 0; s < MEMDEP_LFST_SIZE; s++) {
+        IQE *store = ss->lfst[s].store;
+        if (store != NULL && store->thread == thread && ss->lfst[s].seq > seq)
+            ss->lfst[s].store = NULL;
+    }
+}
+
+void print_memdep_stats(const StoreSets *ss, int mode) {
+    printf("    Memory dependences: %s violations=%d", mode == MEMDEP_STORE_SETS ? "store-sets" : "blind", ss->violations);
+    if (mode == MEMDEP_STORE_SETS) {
+        printf(" delayed=%d avoided=%d false=%d", ss->delayed, ss->avoided, ss->false_deps);
+    }
+    printf("\n");
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "cpu_settings.h"
+#include "rs.h"
+
+// How loads are ordered against older stores
+#define MEMDEP_IDEAL      0     // Loads read memory at commit, they can never be wrong
+#define MEMDEP_BLIND      1     // Loads read at execute ahead of any store, violations squash
+#define MEMDEP_STORE_SETS 2     // Like MEMDEP_BLIND, loads wait for the stores predicted to feed them
+
+typedef struct {
+    IQE *store;                 // Last dispatched store of the set still without an address, NULL if none
+    uint64_t seq;
+} LfstEntry;
+
+// Store set memory dependence predictor (Chrysos and Emer). The SSIT maps
+// the pc of a load or store to its store set; the LFST holds the last
+// store of each set in flight. A load or store waits for the address of
+// the last store of its set. Violations put the load and the store in
+// the same set, and the SSIT is cleared every MEMDEP_CLEAR_INTERVAL
+// memory instructions so stale dependences go away.
+typedef struct {
+    int ssit[MEMDEP_SSIT_SIZE];     // Store set of each pc, -1 if none
+    LfstEntry lfst[MEMDEP_LFST_SIZE];
+    int next_set;
+    int until_clear;
+
+    int violations;             // Loads squashed for reading before an older store to their address
+    int delayed;                // Loads made to wait for a store
+    int avoided;                // ... which wrote their address, a squash avoided
+    int false_deps;             // ... which did not, the wait was for nothing
+} StoreSets;
+
+void memdep_init(StoreSets *ss);
+
+bool is_load(int op);
+bool is_store(int op);
+
+// A load or store entered the LSQ. Returns the store it must wait for, or NULL.
+IQE *memdep_dispatch(StoreSets *ss, IQE *iqe);
+
+// The address of `store` is known, nothing waits for it anymore
+void memdep_store_resolved(StoreSets *ss, IQE *store);
+
+// `load` read memory before `store` wrote its address
+void memdep_train(StoreSets *ss, const IQE *store, const IQE *load);
+
+// Forgets the stores of `thread` younger than `seq`, they were squashed
+void memdep_flush(StoreSets *ss, int thread, uint64_t seq);
+
+void print_memdep_stats(const StoreSets *ss, int mode);
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "mshr.h"
+
+void mshr_init(Mshrs *m, int count) {
+    memset(m, 0, sizeof(*m));
+    m->count = count;
+}
+
+bool mshr_full(const Mshrs *m) {
+    return m->busy == m->count;
+}
+
+static void fill(Mshrs *m, int address) {
+    cache_allocate(&m->l1, address)->state = MESI_E;
+}
+
+int mshr_access(Mshrs *m, IQE *load) {
+    int address = load->result_buffer;
+    int line = cache_line_of(address);
+
+    if (cache_lookup(&m->l1, address) != NULL)
+        return MSHR_HIT;
+
+    Mshr *free_entry = NULL;
+    for (int i = 0; i < m->count; i++) {
+        Mshr *e = &m->entries[i];
+
+        if (!e->valid) {
+            if (free_entry == NULL) free_entry = e;
+            continue;
+        }
+
+        if (e->line == line && e->num_targets < MSHR_TARGETS) {
+            e->targets[e->num_targets] = load;
+            e->seqs[e->num_targets] = load->seq;
+            e->num_targets += 1;
+            m->merged += 1;
+            return MSHR_MISS;
+        }
+    }
+
+    // The load comes back next cycle and is counted then
+    if (free_entry == NULL) {
+        m->l1.misses -= 1;
+        m->stall_cycles += 1;
+        return MSHR_STALL;
+    }
+
+    *free_entry = (Mshr){
+        .valid = true,
+        .line = line,
+        .cycles = L1_MISS_PENALTY,
+        .num_targets = 1,
+        .targets = { load },
+        .seqs = { load->seq },
+    };
+    m->busy += 1;
+    m->misses += 1;
+
+    return MSHR_MISS;
+}
+
+void mshr_tick(Mshrs *m) {
+    if (m->busy == 0)
+        return;
+
+    m->miss_cycles += 1;
+    m->outstanding += m->busy;
+    if (m->busy > m->max_outstanding)
+        m->max_outstanding = m->busy;
+
+    for (int i = 0; i < m->count; i++) {
+        Mshr *e = &m->entries[i];
+        if (!e->valid || --e->cycles > 0)
+            continue;
+
+        fill(m, e->line * L1_LINE_WORDS);
+        for (int k = 0; k < e->num_targets; k++) {
+            if (e->targets[k]->seq == e->seqs[k])
+                e->targets[k]->completed = true;
+        }
+
+        e->valid = false;
+        m->busy -= 1;
+    }
+}
+
+// Stores stay out of the L1's hit and miss counts, those are the loads'
+void mshr_store(Mshrs *m, int address) {
+    CacheLine *line = cache_probe(&m->l1, address);
+
+    if (line == NULL) {
+        fill(m, address);
+    } else {
+        m->l1.stamp += 1;
+        line->lru = m->l1.stamp;
+    }
+}
+
+void print_mshr_stats(const Mshrs *m) {
+    printf("    MSHRs: count=%d misses=%ld merged=%ld MLP=%.2f max=%d stall_cycles=%ld lsq_blocked=%ld\n",
+           m->count, m->misses, m->merged, m->miss_cycles ? (double)m->outstanding / m->miss_cycles : 0.0,
+           m->max_outstanding, m->stall_cycles, m->blocked_cycles);
+    print_cache_stats(&m->l1);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "cpu_settings.h"
+#include "rs.h"
+
+// Outcome of a load looking up the L1
+#define MSHR_HIT   0    // The line is there, the load completes now
+#define MSHR_MISS  1    // The load waits in an MSHR for the line
+#define MSHR_STALL 2    // No MSHR can take the load, it must retry
+
+// Miss status holding register: one line on its way from memory, and the
+// loads waiting for it
+typedef struct {
+    bool valid;
+    int line;
+    int cycles;                         // Left before the line arrives
+    int num_targets;
+    IQE *targets[MSHR_TARGETS];
+    uint64_t seqs[MSHR_TARGETS];        // A squashed target's slot may hold another instruction by then
+} Mshr;
+
+// Non-blocking L1 of a core running alone. Loads look it up once their
+// address is known; a miss takes an MSHR, or joins the one already
+// fetching its line, and frees the MemFU for the next access. Only tags
+// are modeled, values are still read at commit. Stores allocate lines when
+// they commit.
+typedef struct {
+    int count;                          // MSHRs, 0 turns the model off
+    Mshr entries[MSHR_MAX];
+    int busy;
+    Cache l1;
+
+    long misses;                        // Took a new MSHR
+    long merged;                        // Joined an MSHR fetching the same line
+    long stall_cycles;                  // A miss found no MSHR and held the MemFU
+    long blocked_cycles;                // The LSQ held its loads back, every MSHR was busy
+    long miss_cycles;                   // Cycles with a miss outstanding
+    long outstanding;                   // MSHRs busy, summed over those cycles
+    int max_outstanding;
+} Mshrs;
+
+void mshr_init(Mshrs *m, int count);
+
+bool mshr_full(const Mshrs *m);
+
+// Looks up the line of a load whose address is in result_buffer
+int mshr_access(Mshrs *m, IQE *load);
+
+// One cycle of the outstanding misses: arrived lines fill the L1 and complete their loads
+void mshr_tick(Mshrs *m);
+
+// A store committed to `address`, write-allocate
+void mshr_store(Mshrs *m, int address);
+
+void print_mshr_stats(const Mshrs *m);
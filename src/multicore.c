@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "multicore.h"
+
+typedef struct {
+    MultiCore *mc;
+    int core_id;
+} CoreThread;
+
+// Logs hold one quantum of memory accesses, sized in initialize_multicore()
+static void log_request(BusLog *log, BusOp op, int address, int value) {
+    if (log->len == log->cap) {
+        printf("Coherence log overflow\n");
+        exit(1);
+    }
+
+    log->data[log->len] = (BusRequest){
+        .op = op,
+        .address = address,
+        .value = value,
+    };
+    log->len += 1;
+}
+
+// Brings the line holding `address` into the core's cache. The core's own
+// stores from the current quantum are replayed over it since they only reach
+// shared memory at the next barrier.
+static CacheLine *fill_line(MultiCore *mc, int core_id, int address) {
+    CacheLine *line = cache_allocate(&mc->caches[core_id], address);
+    int base = line->tag * L1_LINE_WORDS;
+
+    for (int i = 0; i < L1_LINE_WORDS; i++) {
+        line->data[i] = mc->memory[base + i];
+    }
+
+    BusLog *log = &mc->logs[core_id];
+    for (size_t i = 0; i < log->len; i++) {
+        BusRequest req = log->data[i];
+        if (req.op == BUS_WRITE && cache_line_of(req.address) == line->tag) {
+            line->data[req.address % L1_LINE_WORDS] = req.value;
+        }
+    }
+
+    return line;
+}
+
+int multicore_read(MultiCore *mc, int core_id, int address, int *value) {
+    int latency = 1;
+    CacheLine *line = cache_lookup(&mc->caches[core_id], address);
+
+    if (line == NULL) {
+        line = fill_line(mc, core_id, address);
+        line->state = MESI_S; // Upgraded to E at the barrier if nobody shares it
+        log_request(&mc->logs[core_id], BUS_READ, address, 0);
+        latency = L1_MISS_PENALTY;
+    }
+
+    *value = line->data[address % L1_LINE_WORDS];
+
+    return latency;
+}
+
+int multicore_write(MultiCore *mc, int core_id, int address, int value) {
+    int latency = 1;
+    CacheLine *line = cache_lookup(&mc->caches[core_id], address);
+
+    if (line == NULL) {
+        line = fill_line(mc, core_id, address);
+        latency = L1_MISS_PENALTY;
+    } else if (line->state == MESI_S) {
+        // Needs a bus upgrade, E -> M is silent
+        latency = L1_MISS_PENALTY;
+    }
+
+    line->state = MESI_M;
+    line->data[address % L1_LINE_WORDS] = value;
+    log_request(&mc->logs[core_id], BUS_WRITE, address, value);
+
+    return latency;
+}
+
+// Applies the coherence transactions of the last quantum in core order.
+// Runs on exactly one thread while every core waits at the barrier.
+// Sets `done` once every core halted or the cycle limit is reached.
+void multicore_resolve_quantum(MultiCore *mc) {
+    for (int c = 0; c < mc->num_cores; c++) {
+        BusLog *log = &mc->logs[c];
+
+        for (size_t i = 0; i < log->len; i++) {
+            BusRequest req = log->data[i];
+            bool shared = false;
+
+            for (int o = 0; o < mc->num_cores; o++) {
+                if (o == c) continue;
+
+                CacheLine *other = cache_probe(&mc->caches[o], req.address);
+                if (other == NULL) continue;
+
+                if (req.op == BUS_READ) {
+                    if (other->state == MESI_M) {
+                        mc->caches[o].writebacks += 1;
+                    }
+                    other->state = MESI_S;
+                    shared = true;
+                } else {
+                    other->state = MESI_I;
+                    mc->caches[o].invalidations += 1;
+                }
+            }
+
+            CacheLine *own = cache_probe(&mc->caches[c], req.address);
+            if (req.op == BUS_READ) {
+                if (own != NULL && own->state == MESI_S && !shared) {
+                    own->state = MESI_E;
+                }
+            } else {
+                mc->memory[req.address] = req.value;
+                if (own != NULL) {
+                    own->state = MESI_M;
+                }
+            }
+        }
+
+        log->len = 0;
+    }
+
+    // Every write is now in shared memory, so refresh the surviving copies
+    for (int c = 0; c < mc->num_cores; c++) {
+        for (int s = 0; s < L1_SETS; s++) {
+            for (int w = 0; w < L1_WAYS; w++) {
+                CacheLine *line = &mc->caches[c].lines[s][w];
+                if (line->state == MESI_I) continue;
+
+                memcpy(line->data, &mc->memory[line->tag * L1_LINE_WORDS], sizeof(int) * L1_LINE_WORDS);
+            }
+        }
+    }
+
+    mc->quanta += 1;
+    mc->cycles += mc->quantum;
+
+    bool all_halted = true;
+    for (int c = 0; c < mc->num_cores; c++) {
+        all_halted &= mc->halted[c];
+    }
+
+    mc->done = all_halted || mc->cycles >= mc->max_cycles;
+}
+
+static void *core_thread(void *arg) {
+    CoreThread *ct = (CoreThread *)arg;
+    MultiCore *mc = ct->mc;
+    int id = ct->core_id;
+
+    while (true) {
+        for (int i = 0; i < mc->quantum && !mc->halted[id]; i++) {
+            if (simulate_cycle(&mc->cores[id])) {
+                mc->halted[id] = true;
+            }
+        }
+
+        if (pthread_barrier_wait(&mc->barrier) == PTHREAD_BARRIER_SERIAL_THREAD) {
+            multicore_resolve_quantum(mc);
+        }
+        pthread_barrier_wait(&mc->barrier);
+
+        if (mc->done) break;
+    }
+
+    return NULL;
+}
+
+bool initialize_multicore(MultiCore *mc, char **asm_files, int num_cores, int quantum) {
+    if (num_cores < 1 || num_cores > MULTICORE_MAX_CORES) {
+        printf("Number of cores must be between 1 and %d.\n", MULTICORE_MAX_CORES);
+        return false;
+    }
+
+    memset(mc, 0, sizeof(MultiCore));
+    mc->num_cores = num_cores;
+    mc->quantum = quantum > 0 ? quantum : MULTICORE_QUANTUM;
+    mc->max_cycles = MULTICORE_MAX_CYCLES;
+
+    // Cores and logs never change size, one fixed pool holds them
+    size_t log_bytes = (size_t)(mc->quantum + 1) * L1_LINE_WORDS * sizeof(BusRequest);
+    mc->pool = arena_fixed(num_cores * (sizeof(Cpu) + log_bytes + 64));
+    mc->cores = arena_alloc(&mc->pool, num_cores * sizeof(Cpu));
+
+    for (int i = 0; i < num_cores; i++) {
+        mc->cores[i] = initialize_cpu(asm_files[i]);
+        mc->cores[i].mc = mc;
+        mc->cores[i].core_id = i;
+
+        // At most one store or load commits per cycle, or a store buffer
+        // entry drains, writing up to a line
+        mc->logs[i].cap = (mc->quantum + 1) * L1_LINE_WORDS;
+        mc->logs[i].data = arena_alloc(&mc->pool, log_bytes);
+    }
+
+    return true;
+}
+
+void multicore_set_memory(MultiCore *mc, char *filename) {
+    read_memory_file(mc->memory, filename);
+}
+
+void multicore_run(MultiCore *mc) {
+    pthread_t threads[MULTICORE_MAX_CORES];
+    CoreThread args[MULTICORE_MAX_CORES];
+
+    pthread_barrier_init(&mc->barrier, NULL, mc->num_cores);
+
+    for (int i = 0; i < mc->num_cores; i++) {
+        args[i] = (CoreThread){ .mc = mc, .core_id = i };
+        if (pthread_create(&threads[i], NULL, core_thread, &args[i]) != 0) {
+            printf("Failed to start thread for core %d\n", i);
+            exit(1);
+        }
+    }
+
+    for (int i = 0; i < mc->num_cores; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_barrier_destroy(&mc->barrier);
+}
+
+void multicore_free(MultiCore *mc) {
+    for (int i = 0; i < mc->num_cores; i++) {
+        free_cpu(&mc->cores[i]);
+    }
+    arena_release(&mc->pool);
+    mc->cores = NULL;
+}
+
+void print_multicore_stats(const MultiCore *mc) {
+    printf("Multicore: cores=%d quantum=%d quanta=%lu cycles=%d\n",
+           mc->num_cores, mc->quantum, mc->quanta, mc->cycles);
+
+    for (int i = 0; i < mc->num_cores; i++) {
+        const Cpu *cpu = &mc->cores[i];
+        double ipc = cpu->cycles ? (double)cpu->committed / cpu->cycles : 0.0;
+
+        printf("Core %d: %s cycles=%d committed=%d IPC=%.3f\n",
+               i, mc->halted[i] ? "halted" : "running", cpu->cycles, cpu->committed, ipc);
+        print_cache_stats(&mc->caches[i]);
+        print_stats(cpu);
+    }
+
+    printf("Shared Data Memory:\n");
+    for (int i = 0; i < 20; i++) {
+        printf("    [%d] = %d\n", i, mc->memory[i]);
+    }
+}
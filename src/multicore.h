@@ -0,0 +1,75 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "arena.h"
+#include "cache.h"
+#include "cpu.h"
+#include "cpu_settings.h"
+
+typedef enum {
+    BUS_READ,   // Read miss filled from shared memory
+    BUS_WRITE,  // Store that needs ownership of the line
+} BusOp;
+
+// Coherence transaction recorded by a core during a quantum
+typedef struct {
+    BusOp op;
+    int address;
+    int value;
+} BusRequest;
+
+typedef struct {
+    BusRequest *data;
+    size_t len, cap;
+} BusLog;
+
+// N cores sharing one data memory through private MESI caches.
+//
+// Each core runs on its own host thread for `quantum` cycles against its
+// private cache and a read-only view of `memory`. Coherence transactions are
+// logged and applied at the barrier in core order, so results only depend on
+// the quantum, never on host thread scheduling.
+typedef struct {
+    int num_cores;
+    int quantum;
+    int max_cycles;
+
+    Arena pool;                     // Cores and logs, sized once
+    Cpu *cores;
+    Cache caches[MULTICORE_MAX_CORES];
+    BusLog logs[MULTICORE_MAX_CORES];
+    bool halted[MULTICORE_MAX_CORES];
+
+    int memory[DATA_MEMORY_SIZE];   // Globally visible memory, updated at barriers
+
+    pthread_barrier_t barrier;
+    bool done;
+    int cycles;                     // Global cycles simulated so far
+    size_t quanta;                  // Quanta completed so far
+} MultiCore;
+
+// Loads one program per core. Returns false if too many programs are given.
+bool initialize_multicore(MultiCore *mc, char **asm_files, int num_cores, int quantum);
+
+// Loads shared data memory from a comma separated file
+void multicore_set_memory(MultiCore *mc, char *filename);
+
+// Runs every core on its own host thread until all cores halt
+void multicore_run(MultiCore *mc);
+
+// Applies the coherence transactions logged by every core in the last
+// quantum. `multicore_run()` calls it at each barrier, a caller stepping
+// the cores itself calls it after each quantum.
+void multicore_resolve_quantum(MultiCore *mc);
+
+void multicore_free(MultiCore *mc);
+
+void print_multicore_stats(const MultiCore *mc);
+
+// Memory port used by `commit()` of a core that belongs to a MultiCore.
+// Returns the number of cycles the access took.
+int multicore_read(MultiCore *mc, int core_id, int address, int *value);
+int multicore_write(MultiCore *mc, int core_id, int address, int value);
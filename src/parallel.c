@@ -0,0 +1,157 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "macros.h"
+#include "parallel.h"
+
+double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void add_checkpoint(ParallelRun *run, const Emulator *emu) {
+    int n = run->num_intervals;
+
+    // Checkpoints are allocated one by one, so growing the array never moves them
+    if ((n & (n - 1)) == 0) {
+        int cap = n ? n * 2 : 1;
+        run->checkpoints = arena_grow(&run->arena, run->checkpoints, sizeof(Checkpoint *) * n, sizeof(Checkpoint *) * cap);
+    }
+
+    run->checkpoints[n] = arena_alloc(&run->arena, sizeof(Checkpoint));
+    checkpoint_save(run->checkpoints[n], emu);
+    run->num_intervals += 1;
+}
+
+void parallel_checkpoint(ParallelRun *run, char *asm_file, const int *memory, long interval_len, int warmup) {
+    assert(interval_len > 0 && warmup >= 0);
+
+    memset(run, 0, sizeof(*run));
+    run->interval_len = interval_len;
+    run->warmup = warmup;
+    run->asm_file = asm_file;
+    run->arena = arena_new(1024 * 1024);
+
+    double start = wall_seconds();
+
+    InstructionList code = parse(asm_file, &run->arena);
+    int *scratch = arena_alloc(&run->arena, sizeof(int) * DATA_MEMORY_SIZE);
+    memcpy(scratch, memory, sizeof(int) * DATA_MEMORY_SIZE);
+    Emulator emu = emu_new(&code, scratch);
+
+    // The checkpoint of an interval is taken `warmup` instructions before it
+    while (!emu.halted) {
+        long next_start = run->num_intervals * interval_len;
+        if ((long)emu.executed >= next_start - warmup) {
+            add_checkpoint(run, &emu);
+            continue;
+        }
+
+        emu_step(&emu);
+    }
+
+    // The last checkpoint may come after the end of the program
+    run->instructions = emu.executed;
+    while (run->num_intervals > 1 && (run->num_intervals - 1) * interval_len >= run->instructions) {
+        run->num_intervals -= 1;
+    }
+
+    run->cycles = arena_alloc(&run->arena, sizeof(int) * run->num_intervals);
+    run->functional_seconds = wall_seconds() - start;
+}
+
+typedef struct {
+    ParallelRun *run;
+    Cpu *cpu;
+    double busy;
+} Worker;
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    ParallelRun *run = w->run;
+    double start = wall_seconds();
+
+    for (;;) {
+        int i = atomic_fetch_add(&run->next, 1);
+        if (i >= run->num_intervals)
+            break;
+
+        long first = i * run->interval_len;
+        run->cycles[i] = simulate_interval(w->cpu, &run->checkpoints[i]->emu, first, first + run->interval_len);
+    }
+
+    w->busy = wall_seconds() - start;
+    return NULL;
+}
+
+void parallel_simulate(ParallelRun *run, int jobs) {
+    if (jobs > run->num_intervals) jobs = run->num_intervals;
+    if (jobs > PARALLEL_MAX_JOBS) jobs = PARALLEL_MAX_JOBS;
+    if (jobs < 1) jobs = 1;
+    run->jobs = jobs;
+
+    // Cores are set up before any worker starts, see tagmatch_init()
+    run->cores = arena_alloc(&run->arena, sizeof(Cpu) * jobs);
+    for (int j = 0; j < jobs; j++) {
+        run->cores[j] = initialize_cpu(run->asm_file);
+    }
+
+    Worker workers[PARALLEL_MAX_JOBS];
+    pthread_t threads[PARALLEL_MAX_JOBS];
+    atomic_store(&run->next, 0);
+
+    double start = wall_seconds();
+
+    for (int j = 0; j < jobs; j++) {
+        workers[j] = (Worker){ .run = run, .cpu = &run->cores[j], .busy = 0 };
+        pthread_create(&threads[j], NULL, worker_main, &workers[j]);
+    }
+
+    run->busy_seconds = 0;
+    for (int j = 0; j < jobs; j++) {
+        pthread_join(threads[j], NULL);
+        run->busy_seconds += workers[j].busy;
+    }
+
+    run->detailed_seconds = wall_seconds() - start;
+}
+
+long parallel_cycles(const ParallelRun *run) {
+    long cycles = 0;
+    for (int i = 0; i < run->num_intervals; i++) {
+        cycles += run->cycles[i];
+    }
+
+    return cycles;
+}
+
+void print_parallel_stats(const ParallelRun *run) {
+    long cycles = parallel_cycles(run);
+
+    printf("Parallel: intervals=%d interval=%ld warmup=%d jobs=%d instructions=%ld\n",
+           run->num_intervals, run->interval_len, run->warmup, run->jobs, run->instructions);
+    printf("    Cycles=%ld IPC=%.3f\n", cycles, cycles ? (double)run->instructions / cycles : 0.0);
+    printf("    Wall: functional=%.3fs detailed=%.3fs parallelism=%.2f\n", run->functional_seconds,
+           run->detailed_seconds, run->detailed_seconds > 0 ? run->busy_seconds / run->detailed_seconds : 0.0);
+}
+
+void print_parallel_error(const ParallelRun *run, const Cpu *full, double seconds) {
+    long error = parallel_cycles(run) - full->cycles;
+    double elapsed = run->functional_seconds + run->detailed_seconds;
+
+    printf("    Full simulation: cycles=%d error=%+ld (%.2f%%) wall=%.3fs speedup=%.2fx\n",
+           full->cycles, error, full->cycles ? 100.0 * error / full->cycles : 0.0,
+           seconds, elapsed > 0 ? seconds / elapsed : 0.0);
+}
+
+void parallel_free(ParallelRun *run) {
+    for (int j = 0; run->cores != NULL && j < run->jobs; j++) {
+        free_cpu(&run->cores[j]);
+    }
+
+    arena_release(&run->arena);
+}
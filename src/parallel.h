@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include "arena.h"
+#include "cpu.h"
+#include "emulator.h"
+
+// Interval-parallel simulation of a single-threaded program.
+//
+// A functional pass on the emulator saves a checkpoint `warmup`
+// instructions before the start of every interval of `interval_len`
+// instructions. Worker host threads then take intervals one at a time and
+// simulate each in detail on their own core, from its checkpoint. The
+// cycles of the intervals are added up into the cycles of the whole run.
+typedef struct {
+    long interval_len;
+    int warmup;
+    int jobs;                       // Worker threads
+    char *asm_file;
+
+    Arena arena;
+    Checkpoint **checkpoints;       // One per interval
+    int *cycles;                    // Cycles of each interval
+    int num_intervals;
+    long instructions;              // Executed by the whole program
+
+    Cpu *cores;                     // One per worker
+    atomic_int next;                // Next interval to simulate
+
+    double functional_seconds;
+    double detailed_seconds;        // Wall-clock time of the workers
+    double busy_seconds;            // Summed over the workers
+} ParallelRun;
+
+// Functional pass over `asm_file` with data `memory`, `memory` is left untouched
+void parallel_checkpoint(ParallelRun *run, char *asm_file, const int *memory, long interval_len, int warmup);
+
+// Simulates every interval on `jobs` worker threads
+void parallel_simulate(ParallelRun *run, int jobs);
+
+long parallel_cycles(const ParallelRun *run);
+
+void print_parallel_stats(const ParallelRun *run);
+
+// Compares the estimate against a full simulation that took `seconds`
+void print_parallel_error(const ParallelRun *run, const Cpu *full, double seconds);
+
+void parallel_free(ParallelRun *run);
+
+// Monotonic wall-clock time in seconds
+double wall_seconds(void);
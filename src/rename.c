@@ -1,28 +1,46 @@
+#include <string.h>
+
 #include "rename.h"
+#include "instruction.h"
 #include "macros.h"
 
-void fl_push(FreeList *uprf_fl, int item) {
-    if (uprf_fl->len == FREE_LIST_CAPACITY) {
-        DBG("ERROR", "Tried to push item into a full FreeList. %c", ' ');
+void fl_push(FreeList *fl, int reg) {
+    int bit = reg - fl->base;
+    if (bit < 0 || bit >= FREE_LIST_CAPACITY) {
+        DBG("ERROR", "Tried to free register %d outside of the FreeList.", reg);
         return;
     }
 
-    uprf_fl->len += 1;
-    uprf_fl->data[uprf_fl->tail] = item;
-    uprf_fl->tail = (uprf_fl->tail + 1) % FREE_LIST_CAPACITY;
+    uint64_t mask = (uint64_t)1 << (bit % 64);
+    if (fl->bits[bit / 64] & mask) {
+        DBG("ERROR", "Tried to free register %d twice.", reg);
+        return;
+    }
+
+    fl->bits[bit / 64] |= mask;
+    fl->len += 1;
 }
 
-int fl_pop(FreeList *uprf_fl) {
-    if (uprf_fl->len == 0) {
-        DBG("ERROR", "Tried to pop item from an empty free list. %c", ' ');
-        return -1;
+int fl_pop(FreeList *fl) {
+    for (int w = 0; w < FREE_LIST_WORDS; w++) {
+        if (fl->bits[w] != 0) {
+            int bit = __builtin_ctzll(fl->bits[w]);
+            fl->bits[w] &= fl->bits[w] - 1;
+            fl->len -= 1;
+
+            return fl->base + w * 64 + bit;
+        }
     }
 
-    uprf_fl->len -= 1;
-    int item = uprf_fl->data[uprf_fl->head];
-    uprf_fl->head = (uprf_fl->head + 1) % FREE_LIST_CAPACITY;
+    DBG("ERROR", "Tried to pop item from an empty free list. %c", ' ');
+    return -1;
+}
+
+void release_register(RenameTable *rt, int reg) {
+    uint8_t *refs = &rt->uprf_refs[reg - rt->uprf_fl.base];
 
-    return item;
+    if (--*refs == 0)
+        fl_push(&rt->uprf_fl, reg);
 }
 
 void print_rename_table(RenameTable rt) {
@@ -38,20 +56,26 @@ void print_rename_table(RenameTable rt) {
 	}
 }
 
-RenameTable initialize_rename_table() {
+RenameTable initialize_rename_table(int thread) {
     RenameTable rt = {0};
+    int phys_base = thread * PHYS_REGS_COUNT;
+    int cc_base = thread * CC_REGS_COUNT;
+
+    rt.uprf_fl.base = phys_base;
+    rt.ucrf_fl.base = cc_base;
 
     for (int i = 0; i < PHYS_REGS_COUNT; i++) {
         if (i < ARCH_REGS_COUNT) {
-            rt.table[i] = i;
+            rt.table[i] = phys_base + i;
+            rt.uprf_refs[i] = 1;
         } else {
-            fl_push(&rt.uprf_fl, i);
+            fl_push(&rt.uprf_fl, phys_base + i);
         }
     }
 
-    rt.cc = 0;
+    rt.cc = cc_base;
     for (int i = 1; i < CC_REGS_COUNT; i++) {
-        fl_push(&rt.ucrf_fl, i);
+        fl_push(&rt.ucrf_fl, cc_base + i);
     }
 
     return rt;
@@ -66,27 +90,80 @@ int map_source_register(RenameTable *rt, int arch) {
     return rt->table[arch];
 }
 
-int map_dest_register(RenameTable *rt, int arch) {
+int map_dest_register(RenameTable *rt, int arch, int *old) {
     if (arch >= ARCH_REGS_COUNT) {
         DBG("ERROR", "Invalid architectural register %d", arch);
         return -1;
     }
 
-    int old_mapping = rt->table[arch];
-    rt->table[arch] = fl_pop(&rt->uprf_fl);
-    fl_push(&rt->uprf_fl, old_mapping);
+    int reg = fl_pop(&rt->uprf_fl);
+    if (reg == -1) return -1;
 
-    return rt->table[arch];
+    rt->uprf_refs[reg - rt->uprf_fl.base] = 1;
+    *old = rt->table[arch];
+    rt->table[arch] = reg;
+
+    return reg;
 }
 
-int map_cc_register(RenameTable *rt) {
-    int old_mapping = rt->cc;
-    rt->cc = fl_pop(&rt->ucrf_fl);
-    fl_push(&rt->ucrf_fl, old_mapping);
+int map_alias_register(RenameTable *rt, int arch, int reg, int *old) {
+    if (arch >= ARCH_REGS_COUNT) {
+        DBG("ERROR", "Invalid architectural register %d", arch);
+        return -1;
+    }
 
-    return rt->cc;
+    rt->uprf_refs[reg - rt->uprf_fl.base] += 1;
+    *old = rt->table[arch];
+    rt->table[arch] = reg;
+
+    return reg;
+}
+
+int map_cc_register(RenameTable *rt, int *old) {
+    int cc = fl_pop(&rt->ucrf_fl);
+    if (cc == -1) return -1;
+
+    *old = rt->cc;
+    rt->cc = cc;
+
+    return cc;
 }
 
 int get_cc_register(RenameTable *rt) {
     return rt->cc;
 }
+
+bool rename_can_allocate(RenameTable *rt, bool needs_reg, bool needs_cc) {
+    return (!needs_reg || rt->uprf_fl.len > 0) && (!needs_cc || rt->ucrf_fl.len > 0);
+}
+
+void restore_rename_mapping(RenameTable *rt, const int *table, int cc) {
+    memcpy(rt->table, table, sizeof(rt->table));
+    rt->cc = cc;
+}
+
+void undo_rename(RenameTable *rt, int arch_rd, int prev_rd, int prev_cc) {
+    if (arch_rd != -1)
+        rt->table[arch_rd] = prev_rd;
+
+    if (prev_cc != -1)
+        rt->cc = prev_cc;
+}
+
+int rename_idiom(const Instruction *inst) {
+    switch (inst->op) {
+    case OP_MOVC:
+        return IDIOM_MOVC;
+    case OP_XOR:
+    case OP_SUB:
+        return inst->rs1 == inst->rs2 ? IDIOM_ZERO : IDIOM_NONE;
+    case OP_AND:
+    case OP_OR:
+        return inst->rs1 == inst->rs2 ? IDIOM_MOVE : IDIOM_NONE;
+    case OP_ADDL:
+    case OP_SUBL:
+        return inst->imm == 0 ? IDIOM_MOVE : IDIOM_NONE;
+    }
+
+    return IDIOM_NONE;
+}
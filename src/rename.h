@@ -1,32 +1,75 @@
 #pragma once
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "cpu_settings.h"
+#include "instruction.h"
 
+#define FREE_LIST_WORDS ((FREE_LIST_CAPACITY + 63) / 64)
+
+// Instructions rename can finish by itself, see rename_idiom()
+#define IDIOM_NONE 0
+#define IDIOM_MOVC 1    // MOVC, the value is the immediate
+#define IDIOM_ZERO 2    // XOR or SUB of a register with itself, the value is 0
+#define IDIOM_MOVE 3    // ADDL/SUBL of 0, AND/OR of a register with itself: rd shares the source's register
+
+// Bitmap of the free registers in one thread's partition.
+// Bit i stands for register `base + i`, a set bit means it is free.
 typedef struct {
-    int data[FREE_LIST_CAPACITY];
-    size_t len, head, tail;
+    uint64_t bits[FREE_LIST_WORDS];
+    int base;
+    int len;
 } FreeList;
 
 typedef struct {
     int table[ARCH_REGS_COUNT]; // Mapping from architectural registers to physical registers
     FreeList uprf_fl;
+    uint8_t uprf_refs[FREE_LIST_CAPACITY]; // Mappings of each register, eliminated moves share them
 
     int cc;                     // Mapping for CC register
     FreeList ucrf_fl;
 } RenameTable;
 
-RenameTable initialize_rename_table();
+// Rename table of a hardware thread, mapping into the thread's partition
+// of the physical and cc register files
+RenameTable initialize_rename_table(int thread);
+
+// Returns a register to the free list
+void fl_push(FreeList *fl, int reg);
+
+// Drops one mapping of a physical register, it is free once none is left
+void release_register(RenameTable *rt, int reg);
 
 // Maps given architectural register to a physical register
 int map_source_register(RenameTable *rt, int arch);
 
-// Maps given architectural destination register to a physical register
-int map_dest_register(RenameTable *rt, int arch);
+// Maps given architectural destination register to a physical register.
+// The previous mapping is stored in `old`, it stays allocated until the
+// renamed instruction commits. Returns -1 if no register is free.
+int map_dest_register(RenameTable *rt, int arch, int *old);
+
+// Maps `arch` to the physical register `reg` of an eliminated move, which
+// now has one more mapping. Same contract as map_dest_register.
+int map_alias_register(RenameTable *rt, int arch, int reg, int *old);
 
-// Remaps the current cc register to a new one
-int map_cc_register(RenameTable *rt);
+// Remaps the current cc register to a new one, same contract as map_dest_register
+int map_cc_register(RenameTable *rt, int *old);
 
 // Gets current mapping of cc register
 int get_cc_register(RenameTable *rt);
 
+// Whether renaming can allocate the requested registers this cycle
+bool rename_can_allocate(RenameTable *rt, bool needs_reg, bool needs_cc);
+
+// Restores the mappings of a branch checkpoint. Free lists are not restored,
+// squashed instructions give their registers back individually.
+void restore_rename_mapping(RenameTable *rt, const int *table, int cc);
+
+// Undoes the renaming of one instruction, youngest first: `arch_rd` and the
+// cc register go back to `prev_rd` and `prev_cc` (-1 if it was not renamed)
+void undo_rename(RenameTable *rt, int arch_rd, int prev_rd, int prev_cc);
+
+// What rename can do with `inst`, before its registers are renamed
+int rename_idiom(const Instruction *inst);
+
 void print_rename_table(RenameTable rt);
@@ -2,74 +2,92 @@
 #include "cpu_settings.h"
 #include "macros.h"
 #include "rs.h"
-#include <stdlib.h>
 
-bool rob_get_completed(Rob *rob, IQE *iqe) {
-	if (rob->head == NULL) return false;
+void rob_partition(Rob *rob, int num_threads) {
+	int cap = ROB_CAPACITY / num_threads;
+
+	rob->num_parts = num_threads;
+	for (int t = 0; t < num_threads; t++) {
+		rob->part[t] = (RobPartition){
+			.base = t * cap,
+			.cap = cap,
+			.head = 0,
+			.len = 0,
+		};
+	}
+}
 
-	if (rob->head->iqe.completed) {
-		*iqe = rob->head->iqe;
+IQE *rob_entry(Rob *rob, int thread, int i) {
+	RobPartition *p = &rob->part[thread];
+	return &rob->entries[p->base + (p->head + i) % p->cap];
+}
 
-		RobNode *temp = rob->head;
-		rob->head = temp->next;
-		free(temp);
+IQE *rob_get_completed(Rob *rob, int thread) {
+	RobPartition *p = &rob->part[thread];
+	if (p->len == 0) return NULL;
 
-		rob->len -= 1;
+	IQE *head = rob_entry(rob, thread, 0);
+	if (head->completed) {
+		p->head = (p->head + 1) % p->cap;
+		p->len -= 1;
 
-		return true;
+		return head;
 	}
 
-	return false;
+	return NULL;
+}
+
+BisEntry *rob_bis(Rob *rob, IQE *slot) {
+	return &rob->bis[slot - rob->entries];
 }
 
 IQE *rob_push_iqe(Rob *rob, IQE iqe) {
-	if (rob->len >= ROB_CAPACITY) {
+	RobPartition *p = &rob->part[iqe.thread];
+	if (p->len >= p->cap) {
 		DBG("WARN", "Trying to push instruction to full ROB. %c", ' ');
 		return 0;
 	}
 
-	RobNode *node = (RobNode *)malloc(sizeof(RobNode));
-	if (node == NULL) {
-		DBG("WARN", "Failed to malloc \n %c", ' ');
-		exit(1);
-	}
-	node->iqe = iqe;
-	node->next = NULL;
-
-	rob->len += 1;
-
-	if (rob->head == NULL) {
-		rob->head = node;
+	p->len += 1;
+	IQE *slot = rob_entry(rob, iqe.thread, p->len - 1);
+	*slot = iqe;
 
+	if (DEBUG && p->len == 1) {
 		printf("INFO: ROB Added -> ");
-		print_iqe(&rob->head->iqe);
+		print_iqe(slot);
+	}
 
-		return &rob->head->iqe;
-	} else {
-		RobNode *head = rob->head;
-		while (head->next != NULL) head = head->next;
-		head->next = node;
+	return slot;
+}
 
-		return &head->next->iqe;
-	}
+void rob_remove_last(Rob *rob, int thread) {
+	RobPartition *p = &rob->part[thread];
+	if (p->len == 0) return;
 
-	// return &node->iqe;
+	p->len -= 1;
 }
 
-void rob_flush_after(Rob *rob, int pc) {
-    RobNode *node = rob->head;
-    while (node != NULL) {
-        if (node->iqe.pc == pc) break;
+// Number of entries of the thread that are older than or equal to `iqe`,
+// 0 when `iqe` is NULL, -1 when it is not in the partition.
+static int rob_keep_count(Rob *rob, int thread, IQE *iqe) {
+	if (iqe == NULL) return 0;
+
+	RobPartition *p = &rob->part[thread];
+	int slot = iqe - rob->entries;
+	if (slot < p->base || slot >= p->base + p->cap) return -1;
 
-        node = node->next;
-    }
+	int offset = (slot - p->base - p->head + p->cap) % p->cap;
+	if (offset >= p->len) return -1;
 
-    RobNode *temp = node->next;
-    node->next = NULL;
+	return offset + 1;
+}
+
+void rob_flush_after(Rob *rob, int thread, IQE *iqe) {
+	int keep = rob_keep_count(rob, thread, iqe);
+	if (keep < 0) {
+		DBG("WARN", "Flushing after an instruction that is not in the ROB. %c", ' ');
+		return;
+	}
 
-    while (temp != NULL) {
-        RobNode *next = temp->next;
-        free(temp);
-        temp = next;
-    }
-}
\ No newline at end of file
+	rob->part[thread].len = keep;
+}
@@ -1,22 +1,45 @@
 #pragma once
 
 #include "cpu_settings.h"
+#include "bis.h"
 #include "rs.h"
 
-typedef struct RobNodeStruct {
-	IQE iqe;
-	struct RobNodeStruct *next;
-} RobNode;
-
+// Slots of one hardware thread, used as a circular buffer
 typedef struct {
-	RobNode *head;
+	int base;	// First slot owned by this partition
+	int cap;	// Number of slots owned
+	int head;	// Offset of the oldest entry from base
 	int len;
+} RobPartition;
+
+// Reorder Buffer. The slots are split evenly between the hardware threads,
+// IQE pointers into `entries` stay valid until the entry leaves the ROB.
+typedef struct {
+	IQE entries[ROB_CAPACITY];
+	BisEntry bis[ROB_CAPACITY];	// Snapshot of control instructions, by slot
+	RobPartition part[SMT_MAX_THREADS];
+	int num_parts;
 } Rob;
 
-// Function to remove first item if it is completed
-bool rob_get_completed(Rob *rob, IQE *iqe);
+// Splits the ROB slots evenly between `num_threads` partitions
+void rob_partition(Rob *rob, int num_threads);
+
+// Function to remove first item of a thread if it is completed.
+// The slot is left untouched until the next push.
+IQE *rob_get_completed(Rob *rob, int thread);
 
-// Function to add an IQE to ROB
+// Branch snapshot of the entry in `slot`
+BisEntry *rob_bis(Rob *rob, IQE *slot);
+
+// Function to add an IQE to the partition of `iqe.thread`
 IQE *rob_push_iqe(Rob *rob, IQE iqe);
 
-void rob_flush_after(Rob *rob, int pc);
\ No newline at end of file
+// Removes the youngest entry of a thread (dispatch could not place it in a station)
+void rob_remove_last(Rob *rob, int thread);
+
+// Removes every entry of the thread younger than `iqe` (all of them if NULL)
+// by moving the partition's tail back to the slot after `iqe`
+void rob_flush_after(Rob *rob, int thread, IQE *iqe);
+
+// Returns the i-th oldest entry of a thread
+IQE *rob_entry(Rob *rob, int thread, int i);
@@ -1,7 +1,22 @@
+#include <string.h>
+
 #include "macros.h"
 #include "cpu.h"
 #include "rs.h"
 
+// Reads a source from the forwarded registers, or the register file if it
+// already committed. False if the producer has not completed yet.
+static bool read_source(Cpu *cpu, int phy_reg, int *dest)
+{
+    if (cpu->fw_uprf_valid[phy_reg])
+    {
+        *dest = cpu->fw_uprf[phy_reg];
+        return true;
+    }
+
+    return get_urpf_value(cpu, phy_reg, dest);
+}
+
 IQE make_iqe(void *cpu, Instruction inst)
 {
     Cpu *_cpu = (Cpu *)cpu;
@@ -15,8 +30,18 @@ IQE make_iqe(void *cpu, Instruction inst)
         .rs3 = inst.rs3,
         .imm = inst.imm,
         .cc = inst.cc,
+        .prev_rd = inst.prev_rd,
+        .prev_cc = inst.prev_cc,
+        .arch_rd = inst.arch_rd,
+        .idiom = inst.idiom,
+        .fused_op = inst.fused_op,
+        .fused_imm = inst.fused_imm,
         .pc = inst.pc,
+        .thread = inst.thread,
         .next_pc = inst.next_pc,
+        .trace_index = inst.trace_index,
+        .info = inst.info,
+        .dep_address = -1,
 
         .result_buffer = 0,
         .rs1_value = 0,
@@ -30,24 +55,36 @@ IQE make_iqe(void *cpu, Instruction inst)
         .timestamp = _cpu->cycles,
 
         .completed = false,
-
-        .bis_entry = inst.bis_entry,
     };
 
     if (iqe.rs1 != -1)
     {
-        iqe.rs1_valid = get_urpf_value(*_cpu, iqe.rs1, &iqe.rs1_value);
+        iqe.rs1_valid = read_source(_cpu, iqe.rs1, &iqe.rs1_value);
     }
     if (iqe.rs2 != -1)
     {
-        iqe.rs2_valid = get_urpf_value(*_cpu, iqe.rs2, &iqe.rs2_value);
+        iqe.rs2_valid = read_source(_cpu, iqe.rs2, &iqe.rs2_value);
     }
     if (iqe.rs3 != -1)
     {
-        iqe.rs3_valid = get_urpf_value(*_cpu, iqe.rs3, &iqe.rs3_value);
+        iqe.rs3_valid = read_source(_cpu, iqe.rs3, &iqe.rs3_value);
+    }
+
+    if (_cpu->fw_ucrf_valid[iqe.cc])
+    {
+        iqe.cc_valid = true;
+        iqe.cc_value = _cpu->fw_ucrf[iqe.cc];
+    }
+    else
+    {
+        iqe.cc_valid = get_ucrf_value(_cpu, iqe.cc, &iqe.cc_value);
     }
 
-    iqe.cc_valid = get_ucrf_value(*_cpu, iqe.cc, &iqe.cc_value);
+    // A cc producer only writes its cc register, it never waits on it
+    if (iqe.prev_cc != -1)
+    {
+        iqe.cc_valid = true;
+    }
 
     return iqe;
 }
@@ -96,55 +133,164 @@ void print_iqe(IQE *iqe) {
     printf("}\n");
 }
 
-bool iqe_is_ready(IQE iqe) {
-	bool result = true;
+// Common view of the IRS, MRS and LSQ, which only differ in capacity
+typedef struct {
+    int32_t *tags;  // TAG_ROWS rows of `stride` pending tags
+    int stride;
+    IQE **queue;
+    int *thread_len;
+    int *len;
+    int capacity;
+} RsView;
 
-	if (iqe.rs1 != -1) {
-		result &= iqe.rs1_valid;
-	}
-
-	if (iqe.rs2 != -1) {
-		result &= iqe.rs2_valid;
-	}
-
-	if (iqe.rs3 != -1) {
-		result &= iqe.rs3_valid;
-	}
+#define RS_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define RS_MAX_CAPACITY RS_MAX(IRS_CAPACITY, RS_MAX(MRS_CAPACITY, LSQ_CAPACITY))
 
-    result &= iqe.cc_valid;
+#define RS_VIEW(rs, cap) ((RsView){ &(rs)->tags[0][0], TAG_SLOTS(cap), (rs)->queue, (rs)->thread_len, &(rs)->len, (cap) })
 
-	return result;
+static int32_t pending_tag(int reg, bool valid) {
+    return (reg != -1 && !valid) ? reg : -1;
 }
 
-bool send_to_irs(Cpu *cpu, IQE *iqe)
+static bool rs_push(RsView rs, IQE *iqe)
 {
-    if (cpu->irs.len >= IRS_CAPACITY)
+    if (*rs.len >= rs.capacity)
         return false;
 
-    cpu->irs.queue[cpu->irs.len] = iqe;
-    cpu->irs.len += 1;
+    int i = *rs.len;
+    rs.queue[i] = iqe;
+    rs.tags[0 * rs.stride + i] = pending_tag(iqe->rs1, iqe->rs1_valid);
+    rs.tags[1 * rs.stride + i] = pending_tag(iqe->rs2, iqe->rs2_valid);
+    rs.tags[2 * rs.stride + i] = pending_tag(iqe->rs3, iqe->rs3_valid);
+    rs.tags[TAG_ROW_CC * rs.stride + i] = pending_tag(iqe->cc, iqe->cc_valid);
+    rs.thread_len[iqe->thread] += 1;
+    *rs.len += 1;
 
     return true;
 }
 
-bool send_to_mrs(Cpu *cpu, IQE *iqe)
+static void rs_remove(RsView rs, int index)
 {
-    if (cpu->mrs.len >= MRS_CAPACITY)
-        return false;
+    if (index >= *rs.len) {
+        DBG("WARN", "`rs_remove` : Trying to remove item beyond queue length. Len: %d, Index: %d", *rs.len, index);
+        return;
+    }
 
-    cpu->mrs.queue[cpu->mrs.len] = iqe;
-    cpu->mrs.len += 1;
+    rs.thread_len[rs.queue[index]->thread] -= 1;
 
-    return true;
+    int moved = *rs.len - index - 1;
+    memmove(&rs.queue[index], &rs.queue[index + 1], sizeof(IQE *) * moved);
+    for (int k = 0; k < TAG_ROWS; k++) {
+        int32_t *row = rs.tags + k * rs.stride;
+        memmove(&row[index], &row[index + 1], sizeof(int32_t) * moved);
+    }
+
+    *rs.len -= 1;
+}
+
+// Entries stay in dispatch order, so the thread's squashed entries start
+// at its first one younger than `seq` and nothing before it moves
+static void rs_flush_after(RsView rs, int thread, uint64_t seq)
+{
+    if (rs.thread_len[thread] == 0) return;
+
+    int first = 0;
+    while (first < *rs.len && (rs.queue[first]->thread != thread || rs.queue[first]->seq <= seq)) {
+        first += 1;
+    }
+
+    int kept = first;
+    for (int i = first; i < *rs.len; i++) {
+        if (rs.queue[i]->thread == thread) {
+            rs.thread_len[thread] -= 1;
+            continue;
+        }
+
+        rs.queue[kept] = rs.queue[i];
+        for (int k = 0; k < TAG_ROWS; k++) {
+            rs.tags[k * rs.stride + kept] = rs.tags[k * rs.stride + i];
+        }
+        kept += 1;
+    }
+
+    *rs.len = kept;
+}
+
+// Wakes up every source waiting on `phy_reg`
+static void rs_broadcast(RsView rs, int phy_reg, int reg_value)
+{
+    uint64_t hits[TAG_MASK_WORDS(RS_MAX_CAPACITY)];
+
+    for (int k = 0; k < 3; k++) {
+        int32_t *row = rs.tags + k * rs.stride;
+        tag_kernel->match(row, *rs.len, phy_reg, hits);
+
+        for (int w = 0; w < TAG_MASK_WORDS(*rs.len); w++) {
+            for (uint64_t bits = hits[w]; bits; bits &= bits - 1) {
+                int i = w * 64 + __builtin_ctzll(bits);
+                IQE *iqe = rs.queue[i];
+
+                row[i] = -1;
+                if (k == 0) { iqe->rs1_value = reg_value; iqe->rs1_valid = true; }
+                if (k == 1) { iqe->rs2_value = reg_value; iqe->rs2_valid = true; }
+                if (k == 2) { iqe->rs3_value = reg_value; iqe->rs3_valid = true; }
+            }
+        }
+    }
+}
+
+// Takes out the oldest entry with nothing pending that `accept` takes (any if NULL)
+static bool rs_take_first_ready(RsView rs, bool (*accept)(int op), IQE **dest)
+{
+    uint64_t hits[TAG_MASK_WORDS(RS_MAX_CAPACITY)];
+
+    if (*rs.len == 0) return false;
+
+    tag_kernel->ready(rs.tags, rs.stride, *rs.len, hits);
+
+    for (int w = 0; w < TAG_MASK_WORDS(*rs.len); w++) {
+        for (uint64_t bits = hits[w]; bits; bits &= bits - 1) {
+            int i = w * 64 + __builtin_ctzll(bits);
+            if (accept != NULL && !accept(rs.queue[i]->op))
+                continue;
+
+            *dest = rs.queue[i];
+            rs_remove(rs, i);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool send_to_irs(Cpu *cpu, IQE *iqe)
+{
+    return rs_push(RS_VIEW(&cpu->irs, IRS_CAPACITY), iqe);
+}
+
+// The MRS and LSQ never read cc
+bool send_to_mrs(Cpu *cpu, IQE *iqe)
+{
+    iqe->cc_valid = true;
+    return rs_push(RS_VIEW(&cpu->mrs, MRS_CAPACITY), iqe);
 }
 
 bool send_to_lsq(Cpu *cpu, IQE *iqe)
 {
-    if (cpu->lsq.len >= LSQ_CAPACITY)
+    RsView rs = RS_VIEW(&cpu->lsq, LSQ_CAPACITY);
+
+    iqe->cc_valid = true;
+    if (!rs_push(rs, iqe))
         return false;
 
-    cpu->lsq.queue[cpu->lsq.len] = iqe;
-    cpu->lsq.len += 1;
+    // Waiting for a store's address uses the cc row, the LSQ has no other use for it
+    if (cpu->memdep_mode == MEMDEP_STORE_SETS)
+    {
+        IQE *store = memdep_dispatch(&cpu->memdep, iqe);
+        if (store != NULL)
+            rs.tags[TAG_ROW_CC * rs.stride + *rs.len - 1] = store_tag(cpu, store);
+    }
 
     return true;
 }
@@ -155,272 +301,121 @@ bool send_to_reservation_station(void *cpu, IQE *iqe)
 
     // IQE iqe = make_iqe(_cpu, inst);
 
-    switch (iqe->op)
+    switch (iqe->info->station)
     {
-
-    case OP_ADD:
-    case OP_SUB:
-    case OP_AND:
-    case OP_OR:
-    case OP_XOR:
-    case OP_MOVC:
-    case OP_BZ:
-    case OP_BNZ:
-    case OP_ADDL:
-    case OP_SUBL:
-    case OP_CMP:
-    case OP_CML:
-    case OP_BP:
-    case OP_BN:
-    case OP_BNP:
-    case OP_JUMP:
-    case OP_JALP:
-    case OP_RET:
-    case OP_HALT:
-    case OP_NOP:
+    case STATION_IRS:
     {
         DBG("INFO", "Sent instruction 0x%x to IRS", iqe->op);
         return send_to_irs(_cpu, iqe);
     }
 
-    case OP_LOAD:
-    case OP_STORE:
-    case OP_LDR:
-    case OP_STR:
+    case STATION_LSQ:
     {
         DBG("INFO", "Sent instruction 0x%x to LSQ", iqe->op);
         return send_to_lsq(_cpu, iqe);
     }
 
-    case OP_DIV:
-    case OP_MUL:
+    case STATION_MRS:
     {
         DBG("INFO", "Sent instruction 0x%x to MRS", iqe->op);
         return send_to_mrs(_cpu, iqe);
     }
 
     default:
-        DBG("ERROR", "Unknown Opcode `0x%x` encountered in `send_to_reservation_station`", iqe->op);
+        DBG("ERROR", "Unknown station %d of opcode `0x%x` in `send_to_reservation_station`", iqe->info->station, iqe->op);
     }
 
     return false;
 }
 
-void queue_remove_entry(IQE **queue, int *len, int index) {
-    if (index >= *len) {
-        DBG("WARN", "`queue_remove_entry` : Trying to remove item beyond queue length. Len: %d, Index: %d", *len, index);
-        return;
-    }
-
-    for (int i = index + 1; i < *len; i++) {
-        queue[i - 1] = queue[i];
-    }
-
-    *len -= 1;
-}
-
 bool irs_get_first_ready_iqe(void *cpu, IQE **dest) {
     Cpu *_cpu = (Cpu *)cpu;
 
-    if (_cpu->irs.len == 0) return false;
-
-    for (int i = 0; i < _cpu->irs.len; i++) {
-        IQE *iqe = _cpu->irs.queue[i];
-
-        // TODO: Do we need to check uprf as well?
-        // Try to get values from fw_uprf
-        if (iqe->rs1 != -1 && !iqe->rs1_valid) {
-            if (_cpu->fw_uprf_valid[iqe->rs1]) {
-                iqe->rs1_value = _cpu->fw_uprf[iqe->rs1];
-                iqe->rs1_valid = true;
-            }
-        }
-        
-        if (iqe->rs2 != -1 && !iqe->rs2_valid) {
-            if (_cpu->fw_uprf_valid[iqe->rs2]) {
-                iqe->rs2_value = _cpu->fw_uprf[iqe->rs2];
-                iqe->rs2_valid = true;
-            }
-        }
-
-        if (iqe->rs3 != -1 && !iqe->rs3_valid) {
-            if (_cpu->fw_uprf_valid[iqe->rs3]) {
-                iqe->rs3_value = _cpu->fw_uprf[iqe->rs3];
-                iqe->rs3_valid = true;
-            }
-        }
-
-        if (_cpu->fw_ucrf_valid[iqe->cc]) {
-            iqe->cc_valid = true;
-            iqe->cc_value = _cpu->fw_ucrf[iqe->cc];
-        }
-
-        if (iqe_is_ready(*iqe)) {
-            *dest = iqe;
-
-            queue_remove_entry(_cpu->irs.queue, &_cpu->irs.len, i);
-
-            return true;
-        }
-    }
-
-    return false;
+    return rs_take_first_ready(RS_VIEW(&_cpu->irs, IRS_CAPACITY), NULL, dest);
 }
 
 bool mrs_get_first_ready_iqe(void *cpu, IQE **dest) {
     Cpu *_cpu = (Cpu *)cpu;
 
-    if (_cpu->mrs.len == 0) return false;
-
-    for (int i = 0; i < _cpu->mrs.len; i++) {
-        IQE *iqe = _cpu->mrs.queue[i];
-    
-        // TODO: Do we need to check uprf as well?
-        // Try to get values from fw_uprf
-        if (iqe->rs1 != -1 && !iqe->rs1_valid) {
-            if (_cpu->fw_uprf_valid[iqe->rs1]) {
-                iqe->rs1_value = _cpu->fw_uprf[iqe->rs1];
-                iqe->rs1_valid = true;
-            }
-        }
-        
-        if (iqe->rs2 != -1 && !iqe->rs2_valid) {
-            if (_cpu->fw_uprf_valid[iqe->rs2]) {
-                iqe->rs2_value = _cpu->fw_uprf[iqe->rs2];
-                iqe->rs2_valid = true;
-            }
-        }
-
-        if (iqe->rs3 != -1 && !iqe->rs3_valid) {
-            if (_cpu->fw_uprf_valid[iqe->rs3]) {
-                iqe->rs3_value = _cpu->fw_uprf[iqe->rs3];
-                iqe->rs3_valid = true;
-            }
-        }
-
-        iqe->cc_valid = true;
-
-        // If IQE is ready move it out
-        if (iqe_is_ready(*iqe)) {
-            *dest = iqe;
-
-            queue_remove_entry(_cpu->mrs.queue, &_cpu->mrs.len, i);
-
-            return true;
-        }
-    }
-
-    return false;
+    return rs_take_first_ready(RS_VIEW(&_cpu->mrs, MRS_CAPACITY), NULL, dest);
 }
 
 bool lsq_get_first_ready_iqe(void *cpu, IQE **dest) {
     Cpu *_cpu = (Cpu *)cpu;
 
-    if (_cpu->lsq.len == 0) return false;
+    // With every MSHR busy a load would likely miss and hold the MemFU, stores go first
+    bool (*accept)(int op) = NULL;
+    if (_cpu->mshrs.count > 0 && mshr_full(&_cpu->mshrs)) {
+        accept = is_store;
+        _cpu->mshrs.blocked_cycles += 1;
+    }
 
-    for (int i = 0; i < _cpu->lsq.len; i++) {
-        IQE *iqe = _cpu->lsq.queue[i];
+    return rs_take_first_ready(RS_VIEW(&_cpu->lsq, LSQ_CAPACITY), accept, dest);
+}
 
-        // TODO: Do we need to check uprf as well?
-        // Try to get values from fw_uprf
-        if (iqe->rs1 != -1 && !iqe->rs1_valid) {
-            if (_cpu->fw_uprf_valid[iqe->rs1]) {
-                iqe->rs1_value = _cpu->fw_uprf[iqe->rs1];
-                iqe->rs1_valid = true;
-            }
-        }
-        
-        if (iqe->rs2 != -1 && !iqe->rs2_valid) {
-            if (_cpu->fw_uprf_valid[iqe->rs2]) {
-                iqe->rs2_value = _cpu->fw_uprf[iqe->rs2];
-                iqe->rs2_valid = true;
-            }
-        }
+void irs_send_forwarded_register(IRS *irs, int phy_reg, int reg_value) {
+    rs_broadcast(RS_VIEW(irs, IRS_CAPACITY), phy_reg, reg_value);
+}
 
-        if (iqe->rs3 != -1 && !iqe->rs3_valid) {
-            if (_cpu->fw_uprf_valid[iqe->rs3]) {
-                iqe->rs3_value = _cpu->fw_uprf[iqe->rs3];
-                iqe->rs3_valid = true;
-            }
-        }
+void mrs_send_forwarded_register(MRS *mrs, int phy_reg, int reg_value) {
+    rs_broadcast(RS_VIEW(mrs, MRS_CAPACITY), phy_reg, reg_value);
+}
 
-        iqe->cc_valid = true;
+void lsq_send_forwarded_register(LSQ *lsq, int phy_reg, int reg_value) {
+    rs_broadcast(RS_VIEW(lsq, LSQ_CAPACITY), phy_reg, reg_value);
+}
 
-        if (iqe_is_ready(*iqe)) {
-            *dest = iqe;
+// Only the IRS has instructions reading cc
+void irs_send_forwarded_cc(IRS *irs, int cc, Cc value) {
+    RsView rs = RS_VIEW(irs, IRS_CAPACITY);
+    uint64_t hits[TAG_MASK_WORDS(IRS_CAPACITY)];
 
-            queue_remove_entry(_cpu->lsq.queue, &_cpu->lsq.len, i);
+    int32_t *row = rs.tags + TAG_ROW_CC * rs.stride;
+    tag_kernel->match(row, *rs.len, cc, hits);
 
-            return true;
+    for (int w = 0; w < TAG_MASK_WORDS(*rs.len); w++) {
+        for (uint64_t bits = hits[w]; bits; bits &= bits - 1) {
+            int i = w * 64 + __builtin_ctzll(bits);
+
+            row[i] = -1;
+            rs.queue[i]->cc_value = value;
+            rs.queue[i]->cc_valid = true;
         }
     }
-
-    return false;
-}
-
-void update_iqe_with_forwarded(IQE *iqe, int phy_reg, int reg_value) {
-	if (iqe->rs1 == phy_reg) {
-		iqe->rs1_value = reg_value;
-		iqe->rs1_valid = true;
-	}
-	if (iqe->rs2 == phy_reg) {
-		iqe->rs2_value = reg_value;
-		iqe->rs2_valid = true;
-	}
-	if (iqe->rs3 == phy_reg) {
-		iqe->rs3_value = reg_value;
-		iqe->rs3_valid = true;
-	}
 }
 
-void irs_send_forwarded_register(IRS *irs, int phy_reg, int reg_value) {
-	for (int i = 0; i < irs->len; i++) {
-		IQE *iqe = irs->queue[i];
+int store_tag(void *cpu, const IQE *store) {
+    Cpu *_cpu = (Cpu *)cpu;
 
-		update_iqe_with_forwarded(iqe, phy_reg, reg_value);
-	}
+    return UPRF_SIZE + (int)(store - _cpu->rob.entries);
 }
 
-void mrs_send_forwarded_register(MRS *mrs, int phy_reg, int reg_value) {
-	for (int i = 0; i < mrs->len; i++) {
-		IQE *iqe = mrs->queue[i];
+void lsq_send_store_address(void *cpu, IQE *store) {
+    Cpu *_cpu = (Cpu *)cpu;
+    RsView rs = RS_VIEW(&_cpu->lsq, LSQ_CAPACITY);
+    uint64_t hits[TAG_MASK_WORDS(LSQ_CAPACITY)];
 
-		update_iqe_with_forwarded(iqe, phy_reg, reg_value);
-	}
-}
+    int32_t *row = rs.tags + TAG_ROW_CC * rs.stride;
+    tag_kernel->match(row, *rs.len, store_tag(_cpu, store), hits);
 
-void lsq_send_forwarded_register(LSQ *lsq, int phy_reg, int reg_value) {
-	for (int i = 0; i < lsq->len; i++) {
-		IQE *iqe = lsq->queue[i];
+    for (int w = 0; w < TAG_MASK_WORDS(*rs.len); w++) {
+        for (uint64_t bits = hits[w]; bits; bits &= bits - 1) {
+            int i = w * 64 + __builtin_ctzll(bits);
 
-		update_iqe_with_forwarded(iqe, phy_reg, reg_value);
-	}
+            row[i] = -1;
+            rs.queue[i]->dep_address = store->result_buffer;
+        }
+    }
 }
 
-
-void irs_flush_after(IRS *irs, int pc) {
-    int i = 0;
-    for (; i < irs->len; i++) {
-        if (irs->queue[i]->pc > pc) break;
-    }
-    
-    irs->len = i;
+void irs_flush_after(IRS *irs, int thread, uint64_t seq) {
+    rs_flush_after(RS_VIEW(irs, IRS_CAPACITY), thread, seq);
 }
 
-void mrs_flush_after(MRS *mrs, int pc) {
-    int i = 0;
-    for (; i < mrs->len; i++) {
-        if (mrs->queue[i]->pc > pc) break;
-    }
-    
-    mrs->len = i;
+void mrs_flush_after(MRS *mrs, int thread, uint64_t seq) {
+    rs_flush_after(RS_VIEW(mrs, MRS_CAPACITY), thread, seq);
 }
 
-void lsq_flush_after(LSQ *lsq, int pc) {
-    int i = 0;
-    for (; i < lsq->len; i++) {
-        if (lsq->queue[i]->pc > pc) break;
-    }
-    
-    lsq->len = i;
-}
\ No newline at end of file
+void lsq_flush_after(LSQ *lsq, int thread, uint64_t seq) {
+    rs_flush_after(RS_VIEW(lsq, LSQ_CAPACITY), thread, seq);
+}
@@ -4,12 +4,16 @@
 
 #include "cpu_settings.h"
 #include "instruction.h"
-#include "bis.h"
+#include "cpu_structs.h"
+#include "tagmatch.h"
 
-// Instruction Queue Entry
+// Instruction Queue Entry. It lives in its ROB slot and holds the payload
+// of the instruction; the stations keep the state they scan every cycle
+// in their own rows, and the branch snapshot is in the ROB side table.
 typedef struct {
     int op; // Opcode
     int pc; // Program Counter
+    int thread; // Hardware thread
 
     int rd;     // Register Index
     int rs1;    // Register Index
@@ -17,6 +21,12 @@ typedef struct {
     int rs3;    // Register Index
     int imm;    // Register Index
     int cc;     // CC register
+    int prev_rd;    // Previous mapping of rd, freed at commit
+    int prev_cc;    // Previous mapping of cc, -1 if cc is not written
+    int arch_rd;    // Architectural rd
+    int idiom;      // IDIOM_* of rename elimination
+    int fused_op;   // Branch fused behind this inst, -1 if none
+    int fused_imm;  // Offset of the fused branch
     int current_pc; //Current Instruction's pc 
     int next_pc;    // Next Instruction's pc   
 
@@ -33,26 +43,34 @@ typedef struct {
 
     size_t timestamp;   // Cycle number
 
+    uint64_t seq;       // Dispatch order, a larger number is younger. Starts at 1
+    long trace_index;   // Replayed trace record, -1 on the wrong path
+    const StaticInfo *info; // Load-time analysis of the instruction
+    int dep_address;    // Address of the store a load was made to wait for, -1 if none
     bool completed;     // Execution completed
-
-    BisEntry bis_entry; // BIS Information
 } IQE;
 
 // Integer Reservation Station
 typedef struct {
+    int32_t tags[TAG_ROWS][TAG_SLOTS(IRS_CAPACITY)] __attribute__((aligned(32))); // Pending tags, same order as queue
     IQE *queue[IRS_CAPACITY];
+    int thread_len[SMT_MAX_THREADS];    // Entries per hardware thread
     int len;
 } IRS;
 
 // Multiply Reservation Station
 typedef struct {
+    int32_t tags[TAG_ROWS][TAG_SLOTS(MRS_CAPACITY)] __attribute__((aligned(32))); // Pending tags, same order as queue
     IQE *queue[MRS_CAPACITY];
+    int thread_len[SMT_MAX_THREADS];    // Entries per hardware thread
     int len;
 } MRS;
 
 // Load Store Queue
 typedef struct {
+    int32_t tags[TAG_ROWS][TAG_SLOTS(LSQ_CAPACITY)] __attribute__((aligned(32))); // Pending tags, same order as queue
     IQE *queue[LSQ_CAPACITY];
+    int thread_len[SMT_MAX_THREADS];    // Entries per hardware thread
     int len;
 } LSQ;
 
@@ -72,10 +90,17 @@ bool lsq_get_first_ready_iqe(void *cpu, IQE **dest);
 
 // Functions to send forwarded data to each RS
 void irs_send_forwarded_register(IRS *irs, int phy_reg, int reg_value);
+void irs_send_forwarded_cc(IRS *irs, int cc, Cc value);
 void mrs_send_forwarded_register(MRS *mrs, int phy_reg, int reg_value);
 void lsq_send_forwarded_register(LSQ *lsq, int phy_reg, int reg_value);
 
-// Flush functions
-void irs_flush_after(IRS *irs, int pc);
-void mrs_flush_after(MRS *mrs, int pc);
-void lsq_flush_after(LSQ *lsq, int pc);
\ No newline at end of file
+// Tag loads and stores wait on for the address of `store`, past the physical registers
+int store_tag(void *cpu, const IQE *store);
+
+// Wakes up the entries waiting for the address of `store`
+void lsq_send_store_address(void *cpu, IQE *store);
+
+// Flush functions, remove every entry of `thread` younger than `seq`
+void irs_flush_after(IRS *irs, int thread, uint64_t seq);
+void mrs_flush_after(MRS *mrs, int thread, uint64_t seq);
+void lsq_flush_after(LSQ *lsq, int thread, uint64_t seq);
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "macros.h"
+#include "sample.h"
+
+// Steps the emulator over what the core committed since the last call
+static void follow_commits(Sampler *s) {
+    while (s->emu.executed < (size_t)s->cpu->committed) {
+        emu_step(&s->emu);
+    }
+}
+
+static void add_sample(Sampler *s, double cpi) {
+    s->samples += 1;
+
+    double delta = cpi - s->cpi_mean;
+    s->cpi_mean += delta / s->samples;
+    s->cpi_m2 += delta * (cpi - s->cpi_mean);
+}
+
+// Detailed warm-up and measurement from the emulator's state. Returns true
+// if the program halted.
+static bool simulate_sample(Sampler *s) {
+    Cpu *cpu = s->cpu;
+    const SampleConfig *c = &s->config;
+
+    load_emulator_state(cpu, &s->emu);
+
+    int measure_from = cpu->committed + c->warmup;
+    int measure_to = measure_from + c->unit;
+    int start_cycle = -1;
+    bool done = false;
+
+    while (!done && cpu->committed < measure_to) {
+        done = simulate_cycle(cpu);
+        follow_commits(s);
+
+        if (start_cycle == -1 && cpu->committed >= measure_from) {
+            start_cycle = cpu->cycles;
+        }
+    }
+
+    s->detailed_instructions += cpu->committed - (measure_from - c->warmup);
+
+    // A program that halts inside the unit leaves it short
+    if (start_cycle != -1 && cpu->committed == measure_to) {
+        add_sample(s, (double)(cpu->cycles - start_cycle) / c->unit);
+    }
+
+    return done;
+}
+
+void sample_run(Sampler *s, Cpu *cpu, SampleConfig config) {
+    assert(cpu->num_threads == 1 && cpu->mc == NULL && "Sampling needs a single-threaded core.");
+    assert(config.unit > 0 && config.warmup >= 0 && config.interval >= config.unit + config.warmup);
+
+    memset(s, 0, sizeof(*s));
+    s->config = config;
+    s->cpu = cpu;
+    memcpy(s->memory, cpu->memory, sizeof(s->memory));
+    s->emu = emu_new(&cpu->threads[0].code, s->memory);
+
+    long fast_forward = config.interval - config.unit - config.warmup;
+
+    while (!s->emu.halted) {
+        for (long i = 0; i < fast_forward && !s->emu.halted; i++) {
+            emu_step(&s->emu);
+        }
+        if (s->emu.halted)
+            break;
+
+        DBG("INFO", "Sample %d at instruction %zu", s->samples, s->emu.executed);
+
+        if (simulate_sample(s))
+            break;
+    }
+
+    s->instructions = s->emu.executed;
+}
+
+void sample_set_exact(Sampler *s, const Cpu *full) {
+    s->exact = true;
+    s->exact_cycles = full->cycles;
+    s->instructions = full->committed;
+    s->detailed_instructions = full->committed;
+    s->cpi_mean = full->committed ? (double)full->cycles / full->committed : 0.0;
+}
+
+double sample_cpi_stdev(const Sampler *s) {
+    return s->samples > 1 ? sqrt(s->cpi_m2 / (s->samples - 1)) : 0.0;
+}
+
+double sample_error(const Sampler *s) {
+    if (s->exact)
+        return 0.0;
+    if (s->samples < 2 || s->cpi_mean == 0.0)
+        return INFINITY;
+
+    return s->config.z * sample_cpi_stdev(s) / sqrt(s->samples) / s->cpi_mean;
+}
+
+double sample_estimated_cycles(const Sampler *s) {
+    if (s->exact)
+        return s->exact_cycles;
+
+    return s->cpi_mean * s->instructions;
+}
+
+// n = (z * V / e)^2 samples, V being the coefficient of variation
+long sample_recommended_interval(const Sampler *s) {
+    const SampleConfig *c = &s->config;
+    long min_interval = c->unit + c->warmup;
+
+    if (s->samples < 2)
+        return s->instructions / 2 > min_interval ? s->instructions / 2 : min_interval;
+
+    double v = sample_cpi_stdev(s) / s->cpi_mean;
+    double n = ceil(pow(c->z * v / c->target_error, 2));
+    if (n < 2)
+        n = 2;
+
+    long interval = (long)(s->instructions / n);
+    return interval > min_interval ? interval : min_interval;
+}
+
+void print_sample_stats(const Sampler *s) {
+    const SampleConfig *c = &s->config;
+    double cycles = sample_estimated_cycles(s);
+    double error = sample_error(s);
+
+    if (s->exact) {
+        printf("Sampling: %ld instructions do not fit one sample of %d after a %d warm-up\n",
+               s->instructions, c->unit, c->warmup);
+        printf("    Simulated in full: CPI=%.3f cycles=%.0f IPC=%.3f (exact)\n",
+               s->cpi_mean, cycles, s->cpi_mean ? 1.0 / s->cpi_mean : 0.0);
+        return;
+    }
+
+    printf("Sampling: unit=%d warmup=%d interval=%ld samples=%d detailed=%.1f%% of %ld instructions\n",
+           c->unit, c->warmup, c->interval, s->samples,
+           s->instructions ? 100.0 * s->detailed_instructions / s->instructions : 0.0, s->instructions);
+
+    if (s->samples < 2) {
+        printf("    Not enough samples for a confidence interval, CPI=%.3f cycles=%.0f\n", s->cpi_mean, cycles);
+        return;
+    }
+
+    printf("    CPI=%.3f stdev=%.3f cycles=%.0f +/- %.0f IPC=%.3f (+/- %.2f%% at z=%.2f, target %.2f%%)\n",
+           s->cpi_mean, sample_cpi_stdev(s), cycles, cycles * error, 1.0 / s->cpi_mean,
+           100.0 * error, c->z, 100.0 * c->target_error);
+}
+
+void print_sample_error(const Sampler *s, const Cpu *full) {
+    double cycles = sample_estimated_cycles(s);
+    double error = cycles - full->cycles;
+    bool inside = (s->exact || s->samples > 1) && fabs(error) <= cycles * sample_error(s);
+
+    printf("    Full simulation: cycles=%d IPC=%.3f error=%+.0f (%.2f%%) %s the confidence interval\n",
+           full->cycles, full->cycles ? (double)full->committed / full->cycles : 0.0,
+           error, full->cycles ? 100.0 * error / full->cycles : 0.0, inside ? "inside" : "outside");
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "emulator.h"
+
+// Window sizes of a sampled run, in committed instructions
+typedef struct {
+    int unit;               // Measured per sample
+    int warmup;             // Simulated in detail before each measurement
+    long interval;          // From one sample to the next, the rest is emulated
+    double target_error;    // Wanted half-width of the confidence interval, relative to the mean
+    double z;               // Half-width of the confidence interval in standard deviations
+} SampleConfig;
+
+// Periodic sampling of a single-threaded core (SMARTS).
+//
+// Each interval is emulated functionally up to `warmup + unit` instructions
+// before its end. The core then restarts from the emulator's architectural
+// state, the warm-up refills its pipeline and the cycles of the last `unit`
+// instructions are one CPI sample. The cycles of the whole program are the
+// mean CPI times the instructions it committed.
+typedef struct {
+    SampleConfig config;
+    Cpu *cpu;
+    Emulator emu;
+    int memory[DATA_MEMORY_SIZE];   // Memory of the emulator
+
+    int samples;
+    double cpi_mean;
+    double cpi_m2;                  // Sum of squared deviations (Welford)
+
+    long instructions;              // Committed by the whole program
+    long detailed_instructions;
+
+    bool exact;                     // No sample fit, the program was simulated in full
+    long exact_cycles;
+} Sampler;
+
+// Runs the program loaded in `cpu`, which must have its memory set
+void sample_run(Sampler *s, Cpu *cpu, SampleConfig config);
+
+// Takes the result of a full detailed run of a program too short to sample
+void sample_set_exact(Sampler *s, const Cpu *full);
+
+double sample_cpi_stdev(const Sampler *s);
+
+// Half-width of the confidence interval relative to the mean CPI
+double sample_error(const Sampler *s);
+
+double sample_estimated_cycles(const Sampler *s);
+
+// Interval that would reach the target error, from the variation measured
+long sample_recommended_interval(const Sampler *s);
+
+void print_sample_stats(const Sampler *s);
+
+// Compares the estimate against a full simulation
+void print_sample_error(const Sampler *s, const Cpu *full);
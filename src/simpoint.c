@@ -0,0 +1,368 @@
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analysis.h"
+#include "macros.h"
+#include "simpoint.h"
+
+#define KMEANS_MAX_ITERATIONS 100
+
+// Deterministic, so the same program always gets the same points
+static double next_random(uint64_t *state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (double)(*state >> 11) / (double)(1ULL << 53);
+}
+
+static void add_interval(SimPoints *sp, const long *counts, const double *projection, int dims, long start, long len) {
+    if (sp->num_intervals == sp->cap_intervals) {
+        int cap = sp->cap_intervals ? sp->cap_intervals * 2 : 64;
+        sp->intervals = arena_grow(&sp->arena, sp->intervals, sizeof(SimInterval) * sp->cap_intervals, sizeof(SimInterval) * cap);
+        sp->vectors = arena_grow(&sp->arena, sp->vectors, sizeof(double) * SIMPOINT_DIMS * sp->cap_intervals,
+                                 sizeof(double) * SIMPOINT_DIMS * cap);
+        sp->cap_intervals = cap;
+    }
+
+    double *v = &sp->vectors[sp->num_intervals * SIMPOINT_DIMS];
+    memset(v, 0, sizeof(double) * SIMPOINT_DIMS);
+    for (int b = 0; b < dims; b++) {
+        if (counts[b] == 0)
+            continue;
+
+        double share = (double)counts[b] / len;
+        for (int j = 0; j < SIMPOINT_DIMS; j++) {
+            v[j] += share * projection[b * SIMPOINT_DIMS + j];
+        }
+    }
+
+    sp->intervals[sp->num_intervals] = (SimInterval){ .start = start, .len = len, .cluster = 0 };
+    sp->num_intervals += 1;
+}
+
+static void write_bbv(FILE *out, const long *counts, int dims) {
+    fputc('T', out);
+    for (int b = 0; b < dims; b++) {
+        if (counts[b] != 0)
+            fprintf(out, ":%d:%ld ", b + 1, counts[b]);
+    }
+    fputc('\n', out);
+}
+
+void simpoint_profile(SimPoints *sp, const InstructionList *code, const int *memory,
+                      long interval_len, int warmup, FILE *bbv) {
+    assert(interval_len > 0 && code->len > 0 && code->data[0].info != NULL);
+
+    memset(sp, 0, sizeof(*sp));
+    sp->arena = arena_new(256 * 1024);
+    sp->interval_len = interval_len;
+    sp->warmup = warmup;
+
+    int dims = code->len;
+    long *counts = arena_alloc(&sp->arena, sizeof(long) * dims);
+
+    // Uniform in [-1, 1] like SimPoint's projection
+    uint64_t seed = 1;
+    double *projection = arena_alloc(&sp->arena, sizeof(double) * dims * SIMPOINT_DIMS);
+    for (int i = 0; i < dims * SIMPOINT_DIMS; i++) {
+        projection[i] = 2.0 * next_random(&seed) - 1.0;
+    }
+
+    int *scratch = arena_alloc(&sp->arena, sizeof(int) * DATA_MEMORY_SIZE);
+    memcpy(scratch, memory, sizeof(int) * DATA_MEMORY_SIZE);
+    Emulator emu = emu_new(code, scratch);
+
+    int block = 0;
+    bool new_block = true;
+    long in_interval = 0;
+
+    // Static leaders, plus whatever follows a control instruction for the
+    // JUMP and RET targets only found while running
+    while (!emu.halted) {
+        int index = (emu.pc - 4000) / 4;
+        emu_step(&emu);
+
+        const StaticInfo *info = code->data[index].info;
+        if (new_block || info->leader)
+            block = index;
+
+        counts[block] += 1;
+        in_interval += 1;
+        new_block = info->needs_bis;
+
+        if (in_interval == interval_len || emu.halted) {
+            if (bbv != NULL)
+                write_bbv(bbv, counts, dims);
+
+            add_interval(sp, counts, projection, dims, emu.executed - in_interval, in_interval);
+            memset(counts, 0, sizeof(long) * dims);
+            in_interval = 0;
+        }
+    }
+
+    sp->instructions = emu.executed;
+}
+
+static double distance2(const double *a, const double *b) {
+    double d = 0;
+    for (int j = 0; j < SIMPOINT_DIMS; j++) {
+        d += (a[j] - b[j]) * (a[j] - b[j]);
+    }
+
+    return d;
+}
+
+// k-means++ seeding then Lloyd iterations. Returns the sum of squared
+// distances. `nearest` is scratch space for one double per interval.
+static double kmeans(const SimPoints *sp, int k, uint64_t seed, double *centroids, int *assign, double *nearest) {
+    int n = sp->num_intervals;
+    const double *v = sp->vectors;
+
+    int first = (int)(next_random(&seed) * n);
+    memcpy(&centroids[0], &v[first * SIMPOINT_DIMS], sizeof(double) * SIMPOINT_DIMS);
+
+    for (int c = 1; c < k; c++) {
+        double total = 0;
+        for (int i = 0; i < n; i++) {
+            nearest[i] = DBL_MAX;
+            for (int j = 0; j < c; j++) {
+                double d = distance2(&v[i * SIMPOINT_DIMS], &centroids[j * SIMPOINT_DIMS]);
+                if (d < nearest[i]) nearest[i] = d;
+            }
+            total += nearest[i];
+        }
+
+        // Far points are more likely, identical points are never picked twice
+        int pick = n - 1;
+        double r = next_random(&seed) * total;
+        for (int i = 0; i < n && total > 0; i++) {
+            r -= nearest[i];
+            if (r < 0) { pick = i; break; }
+        }
+        memcpy(&centroids[c * SIMPOINT_DIMS], &v[pick * SIMPOINT_DIMS], sizeof(double) * SIMPOINT_DIMS);
+    }
+
+    for (int i = 0; i < n; i++) assign[i] = -1;
+
+    double sse = 0;
+    for (int iteration = 0; iteration < KMEANS_MAX_ITERATIONS; iteration++) {
+        bool changed = false;
+        sse = 0;
+
+        for (int i = 0; i < n; i++) {
+            int best = 0;
+            double best_d = DBL_MAX;
+            for (int c = 0; c < k; c++) {
+                double d = distance2(&v[i * SIMPOINT_DIMS], &centroids[c * SIMPOINT_DIMS]);
+                if (d < best_d) { best = c; best_d = d; }
+            }
+
+            changed |= assign[i] != best;
+            assign[i] = best;
+            sse += best_d;
+        }
+
+        if (!changed)
+            break;
+
+        int size[k];
+        memset(size, 0, sizeof(size));
+        memset(centroids, 0, sizeof(double) * k * SIMPOINT_DIMS);
+        for (int i = 0; i < n; i++) {
+            size[assign[i]] += 1;
+            for (int j = 0; j < SIMPOINT_DIMS; j++) {
+                centroids[assign[i] * SIMPOINT_DIMS + j] += v[i * SIMPOINT_DIMS + j];
+            }
+        }
+        for (int c = 0; c < k; c++) {
+            for (int j = 0; j < SIMPOINT_DIMS && size[c]; j++) {
+                centroids[c * SIMPOINT_DIMS + j] /= size[c];
+            }
+        }
+    }
+
+    return sse;
+}
+
+// Bayesian Information Criterion of a clustering (Pelleg and Moore)
+static double bic(const SimPoints *sp, int k, const int *assign, double sse) {
+    int n = sp->num_intervals;
+    double d = SIMPOINT_DIMS;
+
+    double variance = n > k ? sse / (n - k) : 0;
+    if (variance < 1e-12) variance = 1e-12;
+
+    int size[k];
+    memset(size, 0, sizeof(size));
+    for (int i = 0; i < n; i++) size[assign[i]] += 1;
+
+    double likelihood = 0;
+    for (int c = 0; c < k; c++) {
+        if (size[c] == 0)
+            continue;
+
+        likelihood += size[c] * log(size[c]) - size[c] * log(n)
+                    - size[c] / 2.0 * log(2 * M_PI) - size[c] * d / 2.0 * log(variance)
+                    - (size[c] - k) / 2.0;
+    }
+
+    double params = (k - 1) + d * k + 1;
+    return likelihood - params / 2.0 * log(n);
+}
+
+void simpoint_cluster(SimPoints *sp, int max_k) {
+    int n = sp->num_intervals;
+    if (max_k > SIMPOINT_MAX_K) max_k = SIMPOINT_MAX_K;
+    if (max_k > n) max_k = n;
+
+    // Best clustering for every k
+    int *assign = arena_alloc(&sp->arena, sizeof(int) * n * (max_k + 1));
+    int *trial = arena_alloc(&sp->arena, sizeof(int) * n);
+    double *nearest = arena_alloc(&sp->arena, sizeof(double) * n);
+    double centroids[SIMPOINT_MAX_K * SIMPOINT_DIMS];
+
+    for (int k = 1; k <= max_k; k++) {
+        double best = DBL_MAX;
+        for (int s = 0; s < SIMPOINT_SEEDS; s++) {
+            double sse = kmeans(sp, k, 1000 * k + s, centroids, trial, nearest);
+            if (sse < best) {
+                best = sse;
+                memcpy(&assign[n * k], trial, sizeof(int) * n);
+            }
+        }
+
+        sp->bic[k] = bic(sp, k, &assign[n * k], best);
+    }
+
+    // Smallest k scoring at least 90% of the BIC range, as SimPoint does
+    double lo = DBL_MAX, hi = -DBL_MAX;
+    for (int k = 1; k <= max_k; k++) {
+        if (sp->bic[k] < lo) lo = sp->bic[k];
+        if (sp->bic[k] > hi) hi = sp->bic[k];
+    }
+
+    sp->k = 1;
+    while (sp->k < max_k && sp->bic[sp->k] < lo + 0.9 * (hi - lo)) {
+        sp->k += 1;
+    }
+
+    // The interval nearest to its cluster's centroid represents it
+    int k = sp->k;
+    double weight[SIMPOINT_MAX_K] = {0};
+    int size[SIMPOINT_MAX_K] = {0};
+
+    memset(centroids, 0, sizeof(centroids));
+    for (int i = 0; i < n; i++) {
+        int c = assign[n * k + i];
+        sp->intervals[i].cluster = c;
+        size[c] += 1;
+        weight[c] += (double)sp->intervals[i].len / sp->instructions;
+        for (int j = 0; j < SIMPOINT_DIMS; j++) {
+            centroids[c * SIMPOINT_DIMS + j] += sp->vectors[i * SIMPOINT_DIMS + j];
+        }
+    }
+
+    int used = 0;
+    for (int c = 0; c < k; c++) {
+        if (size[c] == 0)
+            continue;
+
+        int best = -1;
+        double best_d = DBL_MAX;
+        for (int i = 0; i < n; i++) {
+            if (sp->intervals[i].cluster != c)
+                continue;
+
+            double d = 0;
+            for (int j = 0; j < SIMPOINT_DIMS; j++) {
+                double mean = centroids[c * SIMPOINT_DIMS + j] / size[c];
+                d += (sp->vectors[i * SIMPOINT_DIMS + j] - mean) * (sp->vectors[i * SIMPOINT_DIMS + j] - mean);
+            }
+            if (d < best_d) { best = i; best_d = d; }
+        }
+
+        sp->points[used] = (SimPoint){ .interval = best, .weight = weight[c], .cpi = 0 };
+        used += 1;
+    }
+
+    sp->k = used;
+}
+
+static int by_start(const void *a, const void *b) {
+    return ((const SimPoint *)a)->interval - ((const SimPoint *)b)->interval;
+}
+
+// Detailed run of one point, `cpu` restarted from its checkpoint
+static void simulate_point(SimPoints *sp, SimPoint *point, Cpu *cpu, const Checkpoint *cp) {
+    const SimInterval *interval = &sp->intervals[point->interval];
+    int cycles = simulate_interval(cpu, &cp->emu, interval->start, interval->start + interval->len);
+
+    sp->detailed_instructions += cpu->committed - cp->emu.executed;
+    point->cpi = (double)cycles / interval->len;
+}
+
+void simpoint_simulate(SimPoints *sp, Cpu *cpu, const int *memory) {
+    assert(cpu->num_threads == 1 && cpu->mc == NULL && "SimPoint needs a single-threaded core.");
+
+    qsort(sp->points, sp->k, sizeof(SimPoint), by_start);
+
+    // Checkpoints are taken in one functional pass, in program order
+    Checkpoint *checkpoints = arena_alloc(&sp->arena, sizeof(Checkpoint) * sp->k);
+    int *scratch = arena_alloc(&sp->arena, sizeof(int) * DATA_MEMORY_SIZE);
+    memcpy(scratch, memory, sizeof(int) * DATA_MEMORY_SIZE);
+    Emulator emu = emu_new(&cpu->threads[0].code, scratch);
+
+    for (int p = 0; p < sp->k; p++) {
+        long at = sp->intervals[sp->points[p].interval].start - sp->warmup;
+        while ((long)emu.executed < at) {
+            emu_step(&emu);
+        }
+
+        checkpoint_save(&checkpoints[p], &emu);
+    }
+
+    for (int p = 0; p < sp->k; p++) {
+        DBG("INFO", "Simulation point %d, interval %d", p, sp->points[p].interval);
+        simulate_point(sp, &sp->points[p], cpu, &checkpoints[p]);
+    }
+}
+
+double simpoint_cpi(const SimPoints *sp) {
+    double cpi = 0;
+    for (int p = 0; p < sp->k; p++) {
+        cpi += sp->points[p].weight * sp->points[p].cpi;
+    }
+
+    return cpi;
+}
+
+void print_simpoints(const SimPoints *sp) {
+    double cpi = simpoint_cpi(sp);
+
+    printf("SimPoint: interval=%ld warmup=%d intervals=%d k=%d detailed=%.1f%% of %ld instructions\n",
+           sp->interval_len, sp->warmup, sp->num_intervals, sp->k,
+           sp->instructions ? 100.0 * sp->detailed_instructions / sp->instructions : 0.0, sp->instructions);
+
+    for (int p = 0; p < sp->k; p++) {
+        const SimPoint *point = &sp->points[p];
+        printf("    Point %d: interval=%d start=%ld weight=%.3f CPI=%.3f\n",
+               p, point->interval, sp->intervals[point->interval].start, point->weight, point->cpi);
+    }
+
+    printf("    CPI=%.3f cycles=%.0f IPC=%.3f\n", cpi, cpi * sp->instructions, cpi ? 1.0 / cpi : 0.0);
+}
+
+void print_simpoint_error(const SimPoints *sp, const Cpu *full) {
+    double cycles = simpoint_cpi(sp) * sp->instructions;
+    double error = cycles - full->cycles;
+
+    printf("    Full simulation: cycles=%d IPC=%.3f error=%+.0f (%.2f%%)\n",
+           full->cycles, full->cycles ? (double)full->committed / full->cycles : 0.0,
+           error, full->cycles ? 100.0 * error / full->cycles : 0.0);
+}
+
+void simpoint_free(SimPoints *sp) {
+    arena_release(&sp->arena);
+}
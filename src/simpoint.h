@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "arena.h"
+#include "cpu.h"
+#include "emulator.h"
+
+// One interval of the profiled program
+typedef struct {
+    long start;             // Index of its first instruction
+    long len;               // Instructions executed in it
+    int cluster;
+} SimInterval;
+
+// Interval simulated in detail for its cluster
+typedef struct {
+    int interval;
+    double weight;          // Share of the program's instructions in the cluster
+    double cpi;             // Measured in detail
+} SimPoint;
+
+// SimPoint-style region selection for a single-threaded program.
+//
+// A functional pass splits execution into fixed-size intervals and records
+// a basic-block vector for each: how many instructions ran in each basic
+// block. The vectors are normalized, randomly projected down to
+// SIMPOINT_DIMS dimensions and clustered with k-means, k picked by BIC.
+// The interval nearest to each centroid represents its cluster and is
+// simulated in detail from a checkpoint. The weighted CPIs give the CPI
+// of the whole program.
+typedef struct {
+    Arena arena;
+    long interval_len;
+    int warmup;             // Detailed instructions before each simulated interval
+
+    long instructions;      // Executed by the whole program
+    int num_intervals;
+    int cap_intervals;
+    SimInterval *intervals;
+    double *vectors;        // num_intervals x SIMPOINT_DIMS
+
+    int k;
+    double bic[SIMPOINT_MAX_K + 1];
+    SimPoint points[SIMPOINT_MAX_K];
+
+    long detailed_instructions;
+} SimPoints;
+
+// Functional pass over the program, `memory` is left untouched. `code` must
+// have been through analyze_program(), its block leaders come from there.
+// Raw vectors go to `bbv` if not NULL, one line per interval in SimPoint's
+// format (T:block:count ...), blocks numbered from 1 by their first instruction.
+void simpoint_profile(SimPoints *sp, const InstructionList *code, const int *memory,
+                      long interval_len, int warmup, FILE *bbv);
+
+// Clusters the intervals with k from 1 to `max_k`, picks the simulation points
+void simpoint_cluster(SimPoints *sp, int max_k);
+
+// Simulates the simulation points in detail on `cpu`, each from a checkpoint
+void simpoint_simulate(SimPoints *sp, Cpu *cpu, const int *memory);
+
+double simpoint_cpi(const SimPoints *sp);
+
+void print_simpoints(const SimPoints *sp);
+
+// Compares the estimate against a full simulation
+void print_simpoint_error(const SimPoints *sp, const Cpu *full);
+
+void simpoint_free(SimPoints *sp);
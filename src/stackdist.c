@@ -0,0 +1,162 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "emulator.h"
+#include "stackdist.h"
+
+// Each set of a profile owns `cap` slots of its tree: twice the lines
+// mapping to it, so compacting always frees half of them
+static int set_capacity(int bits) {
+    return 2 * STACKDIST_LINES >> bits;
+}
+
+static void tree_add(int *tree, int cap, int i, int v) {
+    for (; i <= cap; i += i & -i) tree[i - 1] += v;
+}
+
+static int tree_sum(const int *tree, int i) {
+    int sum = 0;
+    for (; i > 0; i -= i & -i) sum += tree[i - 1];
+    return sum;
+}
+
+// Renumbers the live accesses of a set from 1, keeping their order
+static void compact(SetProfile *p, int bits, int set) {
+    static int order[2 * STACKDIST_LINES];
+    int cap = set_capacity(bits);
+    int *tree = &p->tree[set * cap];
+
+    memset(order, -1, sizeof(int) * cap);
+    for (int line = set; line < STACKDIST_LINES; line += 1 << bits) {
+        if (p->last[line] != 0)
+            order[p->last[line] - 1] = line;
+    }
+
+    memset(tree, 0, sizeof(int) * cap);
+    int now = 0;
+    for (int i = 0; i < cap; i++) {
+        if (order[i] == -1)
+            continue;
+
+        p->last[order[i]] = ++now;
+        tree_add(tree, cap, now, 1);
+    }
+
+    p->now[set] = now;
+}
+
+// Returns false on the first access to the line
+static bool profile_access(SetProfile *p, int bits, int line) {
+    int set = line & ((1 << bits) - 1);
+    int cap = set_capacity(bits);
+    int *tree = &p->tree[set * cap];
+    int last = p->last[line];
+
+    if (last != 0) {
+        // Lines of the set accessed since, each counted at its latest access
+        int distance = tree_sum(tree, p->now[set]) - tree_sum(tree, last);
+        p->hist[distance] += 1;
+
+        tree_add(tree, cap, last, -1);
+        p->last[line] = 0;
+    }
+
+    if (p->now[set] == cap) {
+        compact(p, bits, set);
+    }
+
+    p->last[line] = ++p->now[set];
+    tree_add(tree, cap, p->last[line], 1);
+
+    return last != 0;
+}
+
+void stackdist_init(StackProfiler *sp) {
+    memset(sp, 0, sizeof(*sp));
+}
+
+void stackdist_access(StackProfiler *sp, int address) {
+    assert(address >= 0 && address < DATA_MEMORY_SIZE);
+    int line = cache_line_of(address);
+
+    sp->accesses += 1;
+    for (int bits = 0; bits <= STACKDIST_SET_BITS; bits++) {
+        if (!profile_access(&sp->sets[bits], bits, line) && bits == 0)
+            sp->cold += 1;
+    }
+}
+
+long stackdist_misses(const StackProfiler *sp, int sets, int ways) {
+    int bits = 0;
+    while ((1 << bits) < sets) bits++;
+    assert((1 << bits) == sets && bits <= STACKDIST_SET_BITS);
+
+    long misses = sp->cold;
+    for (int d = ways; d < STACKDIST_LINES; d++) {
+        misses += sp->sets[bits].hist[d];
+    }
+
+    return misses;
+}
+
+static double miss_rate(const StackProfiler *sp, long misses) {
+    return sp->accesses ? 100.0 * misses / sp->accesses : 0.0;
+}
+
+void print_stackdist(const StackProfiler *sp) {
+    printf("Stack distances: accesses=%ld lines_touched=%ld (%d words each)\n", sp->accesses, sp->cold, L1_LINE_WORDS);
+
+    printf("    Miss rate (%%) by sets x ways:\n");
+    printf("    %6s", "sets");
+    for (int ways = 1; ways <= STACKDIST_MAX_WAYS; ways *= 2) {
+        printf(" %6d-way", ways);
+    }
+    printf("\n");
+
+    for (int sets = 1; sets <= 1 << STACKDIST_SET_BITS; sets *= 2) {
+        printf("    %6d", sets);
+        for (int ways = 1; ways <= STACKDIST_MAX_WAYS; ways *= 2) {
+            printf(" %10.2f", miss_rate(sp, stackdist_misses(sp, sets, ways)));
+        }
+        printf("\n");
+    }
+
+    // Doubling the size past the lines touched changes nothing
+    printf("    Fully associative:");
+    for (int lines = 1; lines <= STACKDIST_LINES; lines *= 2) {
+        long misses = stackdist_misses(sp, 1, lines);
+        printf(" %d:%.2f%%", lines * L1_LINE_WORDS, miss_rate(sp, misses));
+        if (misses == sp->cold)
+            break;
+    }
+    printf(" (words:miss rate)\n");
+}
+
+void stackdist_check(const StackProfiler *sp, const InstructionList *code, const int *memory) {
+    static Cache cache;
+    static int scratch[DATA_MEMORY_SIZE];
+    memset(&cache, 0, sizeof(cache));
+    memcpy(scratch, memory, sizeof(scratch));
+
+    Emulator emu = emu_new(code, scratch);
+    long accesses = 0;
+
+    while (!emu.halted) {
+        EmuStep step = emu_step(&emu);
+        if (step.address == -1)
+            continue;
+
+        accesses += 1;
+        if (cache_lookup(&cache, step.address) == NULL) {
+            cache_allocate(&cache, step.address)->state = MESI_E;
+        }
+    }
+
+    long predicted = stackdist_misses(sp, L1_SETS, L1_WAYS);
+    printf("    L1 model (%d sets x %d ways): accesses=%ld misses=%lu, profile predicts %ld%s\n",
+           L1_SETS, L1_WAYS, accesses, cache.misses, predicted,
+           accesses == sp->accesses && (long)cache.misses == predicted ? " (match)" : " (MISMATCH)");
+}
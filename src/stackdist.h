@@ -0,0 +1,46 @@
+#pragma once
+
+#include "cpu_settings.h"
+#include "instruction.h"
+
+#define STACKDIST_LINES (DATA_MEMORY_SIZE / L1_LINE_WORDS)
+
+// LRU stack distances of the accesses with 1 << bits sets. An access hits
+// in a cache of that many sets and W ways iff its distance is below W.
+typedef struct {
+    int last[STACKDIST_LINES];          // Set-local time of each line's last access, 0 if none
+    int tree[2 * STACKDIST_LINES];      // Fenwick tree of each set over its times, live accesses are 1
+    int now[1 << STACKDIST_SET_BITS];   // Set-local time of each set's last access
+    long hist[STACKDIST_LINES];         // Accesses by stack distance
+} SetProfile;
+
+// Single-pass cache profiler fed with the data accesses of commit.
+//
+// Mattson's stack algorithm: with LRU replacement, the access to a line
+// hits in every cache whose associativity exceeds the number of distinct
+// lines of its set touched since the line's previous access. The distance
+// is counted with a Fenwick tree over access times where only the latest
+// access of each line is set (Bennett and Kruskal). One pass gives the
+// miss rate of every associativity for each set count profiled, with
+// L1_LINE_WORDS words per line.
+typedef struct {
+    SetProfile sets[STACKDIST_SET_BITS + 1];
+    long accesses;
+    long cold;                          // First accesses to a line, miss in every cache
+} StackProfiler;
+
+void stackdist_init(StackProfiler *sp);
+
+// Word `address` of data memory was read or written
+void stackdist_access(StackProfiler *sp, int address);
+
+// Misses of an LRU cache with `sets` sets (a power of two up to
+// 1 << STACKDIST_SET_BITS) and `ways` ways
+long stackdist_misses(const StackProfiler *sp, int sets, int ways);
+
+// Miss rates of every configuration, and the fully associative curve
+void print_stackdist(const StackProfiler *sp);
+
+// Runs the accesses of `code` on data `memory` through the L1 model and
+// compares its misses to the profile's for L1_SETS x L1_WAYS
+void stackdist_check(const StackProfiler *sp, const InstructionList *code, const int *memory);
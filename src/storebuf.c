@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "cache.h"
+#include "storebuf.h"
+
+void sb_init(StoreBuffer *sb, int depth, int policy) {
+    memset(sb, 0, sizeof(*sb));
+    sb->depth = depth;
+    sb->policy = policy;
+}
+
+static SbEntry *sb_at(StoreBuffer *sb, int i) {
+    return &sb->entries[(sb->head + i) % STORE_BUFFER_MAX];
+}
+
+static const SbEntry *sb_at_const(const StoreBuffer *sb, int i) {
+    return &sb->entries[(sb->head + i) % STORE_BUFFER_MAX];
+}
+
+bool sb_can_take(const StoreBuffer *sb, int address) {
+    if (sb->len < sb->depth)
+        return true;
+
+    return sb->len > 0 && sb_at_const(sb, sb->len - 1)->line == cache_line_of(address);
+}
+
+void sb_push(StoreBuffer *sb, int address, int value) {
+    int line = cache_line_of(address);
+    int word = address % L1_LINE_WORDS;
+
+    sb->stores += 1;
+
+    SbEntry *e = sb->len > 0 ? sb_at(sb, sb->len - 1) : NULL;
+    if (e != NULL && e->line == line) {
+        sb->coalesced += 1;
+    } else {
+        e = sb_at(sb, sb->len);
+        *e = (SbEntry){ .line = line };
+        sb->len += 1;
+    }
+
+    e->mask |= 1u << word;
+    e->words[word] = value;
+}
+
+bool sb_forward(const StoreBuffer *sb, int address, int *value) {
+    int line = cache_line_of(address);
+    int word = address % L1_LINE_WORDS;
+
+    for (int i = sb->len - 1; i >= 0; i--) {
+        const SbEntry *e = sb_at_const(sb, i);
+        if (e->line == line && e->mask & 1u << word) {
+            *value = e->words[word];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool sb_should_drain(const StoreBuffer *sb, bool flush) {
+    if (sb->len == 0)
+        return false;
+
+    if (flush || sb->policy == SB_DRAIN_EAGER)
+        return true;
+
+    return sb->len * 2 >= sb->depth;
+}
+
+SbEntry sb_pop(StoreBuffer *sb) {
+    SbEntry e = *sb_at(sb, 0);
+
+    sb->head = (sb->head + 1) % STORE_BUFFER_MAX;
+    sb->len -= 1;
+    sb->drained += 1;
+
+    return e;
+}
+
+void print_sb_stats(const StoreBuffer *sb, int cycles) {
+    printf("    Store buffer: depth=%d drain=%s avg=%.2f stores=%ld coalesced=%ld forwarded=%ld drained=%ld"
+           " full_stalls=%ld port_stalls=%ld\n",
+           sb->depth, sb->policy == SB_DRAIN_LAZY ? "lazy" : "eager", cycles ? (double)sb->occupancy / cycles : 0.0,
+           sb->stores, sb->coalesced, sb->forwarded, sb->drained, sb->full_stalls, sb->port_stalls);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "cpu_settings.h"
+
+// When the store buffer writes its oldest entry to memory
+#define SB_DRAIN_EAGER 0    // As soon as the memory port is free
+#define SB_DRAIN_LAZY  1    // Once it is half full, stores have longer to coalesce
+
+// Stores to one line, in the words set in `mask`
+typedef struct {
+    int line;
+    unsigned mask;
+    int words[L1_LINE_WORDS];
+} SbEntry;
+
+// Committed stores on their way to memory. Commit only waits for a store
+// when the buffer is full; the oldest entry is written when the memory
+// port is free. A store joins the youngest entry if it is to the same
+// line, so memory still sees the stores in commit order. Loads at commit
+// take their value from the youngest buffered store to their address.
+typedef struct {
+    int depth;                      // Entries, 0 writes stores to memory at commit
+    int policy;                     // SB_DRAIN_EAGER or SB_DRAIN_LAZY
+    SbEntry entries[STORE_BUFFER_MAX];
+    int head;
+    int len;
+    int busy;                       // Cycles left writing the last drained entry
+    bool port_taken;                // A load at commit used the memory port this cycle
+
+    long stores;
+    long coalesced;                 // Stores that joined the youngest entry
+    long forwarded;                 // Loads that took their value from the buffer
+    long drained;                   // Entries written to memory
+    long full_stalls;               // Cycles a store could not commit, the buffer was full
+    long port_stalls;               // Cycles a load waited for a drain to free the port
+    long occupancy;                 // Entries summed over the cycles, for the average
+} StoreBuffer;
+
+void sb_init(StoreBuffer *sb, int depth, int policy);
+
+// Whether a store to `address` can commit into the buffer
+bool sb_can_take(const StoreBuffer *sb, int address);
+
+void sb_push(StoreBuffer *sb, int address, int value);
+
+// Value of the youngest buffered store to `address`. Returns false if there is none.
+bool sb_forward(const StoreBuffer *sb, int address, int *value);
+
+// Whether the oldest entry should be written, `flush` drains whatever is left
+bool sb_should_drain(const StoreBuffer *sb, bool flush);
+
+SbEntry sb_pop(StoreBuffer *sb);
+
+void print_sb_stats(const StoreBuffer *sb, int cycles);
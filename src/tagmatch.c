@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "tagmatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TAGMATCH_X86 1
+#include <immintrin.h>
+#endif
+
+// Bits at or past len are garbage from the row padding
+static void clear_tail(int len, uint64_t *hits) {
+    if (len % 64) {
+        hits[len / 64] &= ((uint64_t)1 << (len % 64)) - 1;
+    }
+}
+
+static void match_scalar(const int32_t *tags, int len, int32_t tag, uint64_t *hits) {
+    memset(hits, 0, sizeof(uint64_t) * TAG_MASK_WORDS(len));
+
+    for (int i = 0; i < len; i++) {
+        hits[i / 64] |= (uint64_t)(tags[i] == tag) << (i % 64);
+    }
+}
+
+static void ready_scalar(const int32_t *tags, int stride, int len, uint64_t *hits) {
+    memset(hits, 0, sizeof(uint64_t) * TAG_MASK_WORDS(len));
+
+    // Tags are >= -1, so the AND is all ones only when every one is -1
+    for (int i = 0; i < len; i++) {
+        int32_t all = -1;
+        for (int k = 0; k < TAG_ROWS; k++) {
+            all &= tags[k * stride + i];
+        }
+        hits[i / 64] |= (uint64_t)(all == -1) << (i % 64);
+    }
+}
+
+#ifdef TAGMATCH_X86
+
+__attribute__((target("sse2")))
+static void match_sse2(const int32_t *tags, int len, int32_t tag, uint64_t *hits) {
+    memset(hits, 0, sizeof(uint64_t) * TAG_MASK_WORDS(len));
+
+    __m128i key = _mm_set1_epi32(tag);
+    for (int i = 0; i < len; i += 4) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(tags + i)), key);
+        uint64_t bits = (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(eq));
+        hits[i / 64] |= bits << (i % 64);
+    }
+
+    clear_tail(len, hits);
+}
+
+__attribute__((target("sse2")))
+static void ready_sse2(const int32_t *tags, int stride, int len, uint64_t *hits) {
+    memset(hits, 0, sizeof(uint64_t) * TAG_MASK_WORDS(len));
+
+    __m128i none = _mm_set1_epi32(-1);
+    for (int i = 0; i < len; i += 4) {
+        __m128i all = none;
+        for (int k = 0; k < TAG_ROWS; k++) {
+            all = _mm_and_si128(all, _mm_loadu_si128((const __m128i *)(tags + k * stride + i)));
+        }
+        __m128i eq = _mm_cmpeq_epi32(all, none);
+        uint64_t bits = (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(eq));
+        hits[i / 64] |= bits << (i % 64);
+    }
+
+    clear_tail(len, hits);
+}
+
+__attribute__((target("avx2")))
+static void match_avx2(const int32_t *tags, int len, int32_t tag, uint64_t *hits) {
+    memset(hits, 0, sizeof(uint64_t) * TAG_MASK_WORDS(len));
+
+    __m256i key = _mm256_set1_epi32(tag);
+    for (int i = 0; i < len; i += 8) {
+        __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(tags + i)), key);
+        uint64_t bits = (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        hits[i / 64] |= bits << (i % 64);
+    }
+
+    clear_tail(len, hits);
+}
+
+__attribute__((target("avx2")))
+static void ready_avx2(const int32_t *tags, int stride, int len, uint64_t *hits) {
+    memset(hits, 0, sizeof(uint64_t) * TAG_MASK_WORDS(len));
+
+    __m256i none = _mm256_set1_epi32(-1);
+    for (int i = 0; i < len; i += 8) {
+        __m256i all = none;
+        for (int k = 0; k < TAG_ROWS; k++) {
+            all = _mm256_and_si256(all, _mm256_loadu_si256((const __m256i *)(tags + k * stride + i)));
+        }
+        __m256i eq = _mm256_cmpeq_epi32(all, none);
+        uint64_t bits = (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        hits[i / 64] |= bits << (i % 64);
+    }
+
+    clear_tail(len, hits);
+}
+
+#endif
+
+// Narrowest first, tagmatch_init() takes the last supported one
+static const TagKernel kernels[] = {
+    { "scalar", match_scalar, ready_scalar },
+#ifdef TAGMATCH_X86
+    { "sse2",   match_sse2,   ready_sse2 },
+    { "avx2",   match_avx2,   ready_avx2 },
+#endif
+};
+
+#define KERNELS_COUNT ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+const TagKernel *tag_kernel = &kernels[0];
+
+int tagmatch_supported(const TagKernel *kernel) {
+#ifdef TAGMATCH_X86
+    __builtin_cpu_init();
+
+    if (kernel->match == match_sse2) return __builtin_cpu_supports("sse2");
+    if (kernel->match == match_avx2) return __builtin_cpu_supports("avx2");
+#endif
+
+    return kernel->match == match_scalar;
+}
+
+const TagKernel *tagmatch_kernel(int index) {
+    if (index < 0 || index >= KERNELS_COUNT) return NULL;
+
+    return &kernels[index];
+}
+
+int tagmatch_select(const char *name) {
+    for (int i = 0; i < KERNELS_COUNT; i++) {
+        if (strcmp(kernels[i].name, name) == 0 && tagmatch_supported(&kernels[i])) {
+            tag_kernel = &kernels[i];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void tagmatch_init(void) {
+    char *name = getenv("APEX_TAGMATCH");
+    if (name != NULL && tagmatch_select(name)) return;
+
+    for (int i = 0; i < KERNELS_COUNT; i++) {
+        if (tagmatch_supported(&kernels[i])) {
+            tag_kernel = &kernels[i];
+        }
+    }
+}
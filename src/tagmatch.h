@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+// Pending source tags of a reservation station are kept as one row of
+// int32 per source (SoA), so a completed tag is compared against every
+// entry with a few vector compares. A row holds -1 for sources that are
+// not used or already valid.
+
+// Rows: rs1, rs2, rs3 physical registers, then the cc register
+#define TAG_ROW_CC  3
+#define TAG_ROWS    4
+
+// Rows are padded so the vector kernels never need a scalar tail
+#define TAG_SLOTS(n) ((((n) + 7) / 8) * 8)
+
+// Number of uint64_t words of a hit mask for n entries
+#define TAG_MASK_WORDS(n) (((n) + 63) / 64)
+
+// Sets bit i of `hits` where tags[i] == tag, for i < len
+typedef void (*TagMatchFn)(const int32_t *tags, int len, int32_t tag, uint64_t *hits);
+
+// Sets bit i of `hits` where no row of entry i is pending, for i < len.
+// `tags` holds TAG_ROWS rows of `stride` entries.
+typedef void (*TagReadyFn)(const int32_t *tags, int stride, int len, uint64_t *hits);
+
+typedef struct {
+    const char *name;
+    TagMatchFn match;
+    TagReadyFn ready;
+} TagKernel;
+
+// Kernel used by the reservation stations, scalar until tagmatch_init()
+extern const TagKernel *tag_kernel;
+
+// Picks the widest kernel the host supports (cpuid), or the one named
+// by APEX_TAGMATCH (scalar, sse2, avx2). Call before starting threads.
+void tagmatch_init(void);
+
+// Selects a kernel by name, returns 0 if unknown or not supported
+int tagmatch_select(const char *name);
+
+// Kernel by index for benchmarks, NULL past the last one
+const TagKernel *tagmatch_kernel(int index);
+int tagmatch_supported(const TagKernel *kernel);
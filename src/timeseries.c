@@ -0,0 +1,109 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "timeseries.h"
+
+void ts_init(TimeSeries *ts, int interval, Sample *samples, int cap) {
+    *ts = (TimeSeries){
+        .interval = interval,
+        .samples = samples,
+        .cap = cap,
+    };
+}
+
+// Change of the counters from `a` to `b`, occupancies are b's
+static Sample delta(const Sample *a, const Sample *b) {
+    Sample d = *b;
+
+    d.cycle = b->cycle - a->cycle;
+    d.committed = b->committed - a->committed;
+    d.rename_stalls = b->rename_stalls - a->rename_stalls;
+    d.fetch_queue_full = b->fetch_queue_full - a->fetch_queue_full;
+    d.decode_starved = b->decode_starved - a->decode_starved;
+    d.flushes = b->flushes - a->flushes;
+    d.sb_full_stalls = b->sb_full_stalls - a->sb_full_stalls;
+    d.mshr_stalls = b->mshr_stalls - a->mshr_stalls;
+    d.l1_accesses = b->l1_accesses - a->l1_accesses;
+    d.l1_misses = b->l1_misses - a->l1_misses;
+
+    return d;
+}
+
+// Sum of two consecutive intervals, the later one's occupancies
+static Sample merge(const Sample *a, const Sample *b) {
+    Sample m = *b;
+
+    m.cycle = a->cycle + b->cycle;
+    m.committed = a->committed + b->committed;
+    m.rename_stalls = a->rename_stalls + b->rename_stalls;
+    m.fetch_queue_full = a->fetch_queue_full + b->fetch_queue_full;
+    m.decode_starved = a->decode_starved + b->decode_starved;
+    m.flushes = a->flushes + b->flushes;
+    m.sb_full_stalls = a->sb_full_stalls + b->sb_full_stalls;
+    m.mshr_stalls = a->mshr_stalls + b->mshr_stalls;
+    m.l1_accesses = a->l1_accesses + b->l1_accesses;
+    m.l1_misses = a->l1_misses + b->l1_misses;
+
+    return m;
+}
+
+long ts_record(TimeSeries *ts, const Sample *now) {
+    if (now->cycle > ts->last.cycle) {
+        if (ts->len == ts->cap) {
+            for (int i = 0; i < ts->len / 2; i++) {
+                ts->samples[i] = merge(&ts->samples[2 * i], &ts->samples[2 * i + 1]);
+            }
+            if (ts->len % 2) {
+                ts->samples[ts->len / 2] = ts->samples[ts->len - 1];
+            }
+            ts->len = (ts->len + 1) / 2;
+            ts->interval *= 2;
+        }
+
+        ts->samples[ts->len++] = delta(&ts->last, now);
+        ts->last = *now;
+    }
+
+    // Samples stay aligned on the interval after it doubles
+    return (now->cycle / ts->interval + 1) * ts->interval;
+}
+
+void ts_write(const TimeSeries *ts, FILE *f, bool json) {
+    if (json) {
+        fprintf(f, "{\"interval\": %d, \"samples\": [\n", ts->interval);
+    } else {
+        fprintf(f, "cycle,cycles,committed,ipc,irs,mrs,lsq,rob,rename_stalls,fetch_queue_full,decode_starved,"
+                   "flushes,sb_full_stalls,mshr_stalls,l1_accesses,l1_misses,l1_miss_rate\n");
+    }
+
+    long cycle = 0;
+    for (int i = 0; i < ts->len; i++) {
+        const Sample *s = &ts->samples[i];
+        cycle += s->cycle;
+
+        double ipc = s->cycle ? (double)s->committed / s->cycle : 0.0;
+        double miss_rate = s->l1_accesses ? (double)s->l1_misses / s->l1_accesses : 0.0;
+
+        if (json) {
+            fprintf(f, "  {\"cycle\": %ld, \"cycles\": %ld, \"committed\": %ld, \"ipc\": %.4f, "
+                       "\"irs\": %d, \"mrs\": %d, \"lsq\": %d, \"rob\": %d, "
+                       "\"rename_stalls\": %ld, \"fetch_queue_full\": %ld, \"decode_starved\": %ld, "
+                       "\"flushes\": %ld, \"sb_full_stalls\": %ld, \"mshr_stalls\": %ld, "
+                       "\"l1_accesses\": %ld, \"l1_misses\": %ld, \"l1_miss_rate\": %.4f}%s\n",
+                    cycle, s->cycle, s->committed, ipc, s->irs, s->mrs, s->lsq, s->rob,
+                    s->rename_stalls, s->fetch_queue_full, s->decode_starved,
+                    s->flushes, s->sb_full_stalls, s->mshr_stalls,
+                    s->l1_accesses, s->l1_misses, miss_rate, i + 1 < ts->len ? "," : "");
+        } else {
+            fprintf(f, "%ld,%ld,%ld,%.4f,%d,%d,%d,%d,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%.4f\n",
+                    cycle, s->cycle, s->committed, ipc, s->irs, s->mrs, s->lsq, s->rob,
+                    s->rename_stalls, s->fetch_queue_full, s->decode_starved,
+                    s->flushes, s->sb_full_stalls, s->mshr_stalls,
+                    s->l1_accesses, s->l1_misses, miss_rate);
+        }
+    }
+
+    if (json) {
+        fprintf(f, "]}\n");
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Counters of a core at one point of a run. Occupancies are taken at that
+// cycle, everything else counts from the start of the run.
+typedef struct {
+    long cycle;
+    long committed;
+    int irs, mrs, lsq, rob;         // Entries in use
+    long rename_stalls;             // Cycles decode 2 waited for a free register
+    long fetch_queue_full;
+    long decode_starved;
+    long flushes;
+    long sb_full_stalls;            // Cycles a store waited for the full store buffer
+    long mshr_stalls;               // Cycles a load missed with every MSHR busy
+    long l1_accesses;
+    long l1_misses;
+} Sample;
+
+// Counters sampled every `interval` cycles into a buffer allocated up
+// front. Each sample holds the change since the previous one. When the
+// buffer fills, neighbouring samples are merged and the interval doubles,
+// so a run of any length fits.
+typedef struct {
+    int interval;
+    Sample *samples;
+    int len;
+    int cap;
+    Sample last;                    // Counters at the previous sample
+} TimeSeries;
+
+// `samples` holds `cap` entries, at least 2
+void ts_init(TimeSeries *ts, int interval, Sample *samples, int cap);
+
+// Records the interval ending at `now`. Returns the cycle of the next sample.
+long ts_record(TimeSeries *ts, const Sample *now);
+
+// One row per interval, JSON if `json`, CSV otherwise
+void ts_write(const TimeSeries *ts, FILE *f, bool json);
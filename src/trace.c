@@ -0,0 +1,269 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "trace.h"
+
+#define TRACE_MAGIC   "APXTRACE"
+#define TRACE_VERSION 1
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = v >> (8 * i);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Varint of a value with small magnitude, either sign
+static size_t put_varint(unsigned char *p, int32_t value) {
+    uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    size_t n = 0;
+
+    while (v >= 0x80) {
+        p[n++] = v | 0x80;
+        v >>= 7;
+    }
+    p[n++] = v;
+
+    return n;
+}
+
+// Returns the bytes read, 0 if the varint runs past `end`
+static size_t get_varint(const unsigned char *p, const unsigned char *end, int32_t *value) {
+    uint32_t v = 0;
+
+    for (size_t n = 0; n < 5 && p + n < end; n++) {
+        v |= (uint32_t)(p[n] & 0x7f) << (7 * n);
+        if (!(p[n] & 0x80)) {
+            *value = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+            return n + 1;
+        }
+    }
+
+    return 0;
+}
+
+// Identifies the program a trace was recorded from (FNV-1a)
+static uint32_t code_hash(const InstructionList *code) {
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < code->len; i++) {
+        const Instruction *inst = &code->data[i];
+        int fields[] = { inst->op, inst->rd, inst->rs1, inst->rs2, inst->rs3, inst->imm };
+
+        for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+            h = (h ^ (uint32_t)fields[f]) * 16777619u;
+        }
+    }
+
+    return h;
+}
+
+static void write_header(const InstructionList *code, FILE *file) {
+    unsigned char header[20];
+    memcpy(header, TRACE_MAGIC, 8);
+    put_u32(header + 8, TRACE_VERSION);
+    put_u32(header + 12, code->len);
+    put_u32(header + 16, code_hash(code));
+
+    fwrite(header, 1, sizeof(header), file);
+}
+
+void trace_create(TraceWriter *tw, const char *path, const InstructionList *code) {
+    memset(tw, 0, sizeof(*tw));
+
+    tw->file = fopen(path, "wb");
+    if (tw->file == NULL) {
+        printf("Failed to open file %s.\n", path);
+        exit(1);
+    }
+
+    write_header(code, tw->file);
+    tw->total_bytes = 20;
+}
+
+static void flush_chunk(TraceWriter *tw) {
+    unsigned char header[8];
+    put_u32(header, tw->records);
+    put_u32(header + 4, tw->len);
+
+    fwrite(header, 1, sizeof(header), tw->file);
+    fwrite(tw->chunk, 1, tw->len, tw->file);
+
+    tw->total_bytes += sizeof(header) + tw->len;
+    tw->chunks += tw->records > 0;
+    tw->records = 0;
+    tw->len = 0;
+}
+
+void trace_write(TraceWriter *tw, EmuStep step) {
+    // A chunk restarts from its first pc and address 0
+    if (tw->records == 0) {
+        tw->len = put_varint(tw->chunk, step.pc);
+        tw->address = 0;
+    }
+    assert(tw->records == 0 || step.pc == tw->next_pc);
+
+    unsigned char *op = &tw->chunk[tw->len++];
+    *op = step.op;
+
+    if (step.next_pc != step.pc + 4) {
+        *op |= TRACE_TAKEN;
+        tw->len += put_varint(&tw->chunk[tw->len], step.next_pc - step.pc);
+    }
+    if (step.address != -1) {
+        *op |= TRACE_MEMORY;
+        tw->len += put_varint(&tw->chunk[tw->len], step.address - tw->address);
+        tw->address = step.address;
+    }
+
+    tw->next_pc = step.next_pc;
+    tw->records += 1;
+    tw->total_records += 1;
+
+    if (tw->records == TRACE_CHUNK_RECORDS) {
+        flush_chunk(tw);
+    }
+}
+
+void trace_finish(TraceWriter *tw) {
+    if (tw->records > 0) {
+        flush_chunk(tw);
+    }
+
+    // Chunk without records
+    flush_chunk(tw);
+
+    if (fclose(tw->file) != 0) {
+        printf("Failed to write the trace.\n");
+        exit(1);
+    }
+    tw->file = NULL;
+}
+
+void trace_record(TraceWriter *tw, const char *path, const InstructionList *code, const int *memory) {
+    int *scratch = heap_alloc(sizeof(int) * DATA_MEMORY_SIZE);
+    memcpy(scratch, memory, sizeof(int) * DATA_MEMORY_SIZE);
+
+    Emulator emu = emu_new(code, scratch);
+    trace_create(tw, path, code);
+
+    while (!emu.halted) {
+        trace_write(tw, emu_step(&emu));
+    }
+
+    trace_finish(tw);
+    heap_free(scratch);
+}
+
+void print_trace_stats(const TraceWriter *tw) {
+    printf("Trace: instructions=%ld chunks=%d bytes=%ld (%.2f bytes/instruction)\n",
+           tw->total_records, tw->chunks, tw->total_bytes,
+           tw->total_records ? (double)tw->total_bytes / tw->total_records : 0.0);
+}
+
+static void corrupt(const TraceReader *tr) {
+    printf("Trace %s is corrupt.\n", tr->path);
+    exit(1);
+}
+
+void trace_open(TraceReader *tr, const char *path, const InstructionList *code) {
+    memset(tr, 0, sizeof(*tr));
+    tr->path = path;
+
+    tr->file = fopen(path, "rb");
+    if (tr->file == NULL) {
+        printf("Failed to open file %s.\n", path);
+        exit(1);
+    }
+
+    unsigned char header[20];
+    if (fread(header, 1, sizeof(header), tr->file) != sizeof(header) || memcmp(header, TRACE_MAGIC, 8) != 0
+        || get_u32(header + 8) != TRACE_VERSION) {
+        printf("%s is not a trace.\n", path);
+        exit(1);
+    }
+
+    if (get_u32(header + 12) != code->len || get_u32(header + 16) != code_hash(code)) {
+        printf("Trace %s was recorded from another program.\n", path);
+        exit(1);
+    }
+}
+
+// Decodes the next chunk into the window
+static void read_chunk(TraceReader *tr) {
+    unsigned char header[8];
+    if (fread(header, 1, sizeof(header), tr->file) != sizeof(header))
+        corrupt(tr);
+
+    uint32_t records = get_u32(header);
+    uint32_t len = get_u32(header + 4);
+    if (records > TRACE_CHUNK_RECORDS || len > TRACE_CHUNK_BYTES || fread(tr->chunk, 1, len, tr->file) != len)
+        corrupt(tr);
+
+    if (records == 0) {
+        tr->ended = true;
+        return;
+    }
+
+    const unsigned char *p = tr->chunk;
+    const unsigned char *end = tr->chunk + len;
+    int32_t pc, address = 0, delta;
+    size_t n;
+
+    if ((n = get_varint(p, end, &pc)) == 0)
+        corrupt(tr);
+    p += n;
+
+    for (uint32_t i = 0; i < records; i++) {
+        if (p >= end)
+            corrupt(tr);
+
+        TraceRecord *rec = &tr->window[tr->decoded % TRACE_WINDOW];
+        unsigned char op = *p++;
+
+        rec->pc = pc;
+        rec->op = op & TRACE_OP;
+        rec->next_pc = pc + 4;
+        rec->address = -1;
+
+        if (op & TRACE_TAKEN) {
+            if ((n = get_varint(p, end, &delta)) == 0)
+                corrupt(tr);
+            p += n;
+            rec->next_pc = pc + delta;
+        }
+        if (op & TRACE_MEMORY) {
+            if ((n = get_varint(p, end, &delta)) == 0)
+                corrupt(tr);
+            p += n;
+            address += delta;
+            rec->address = address;
+        }
+
+        pc = rec->next_pc;
+        tr->decoded += 1;
+    }
+}
+
+const TraceRecord *trace_get(TraceReader *tr, long index) {
+    assert(index >= 0 && index > tr->decoded - TRACE_WINDOW && "Trace record left the window.");
+
+    while (index >= tr->decoded && !tr->ended) {
+        read_chunk(tr);
+    }
+
+    if (index >= tr->decoded)
+        return NULL;
+
+    return &tr->window[index % TRACE_WINDOW];
+}
+
+void trace_close(TraceReader *tr) {
+    if (tr->file != NULL) {
+        fclose(tr->file);
+    }
+    tr->file = NULL;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cpu_settings.h"
+#include "emulator.h"
+#include "instruction.h"
+
+// Execution traces: the committed dynamic instruction stream of a program,
+// recorded once on the emulator and replayed into the timing model.
+//
+// Replay gives no speedup. It still steps the whole pipeline every cycle and
+// only skips computing values, which decoding the trace costs about as much
+// as. What it buys is timing runs that need neither the data nor a
+// functional re-execution.
+//
+// The file is a header identifying the program, then chunks of up to
+// TRACE_CHUNK_RECORDS records. A chunk starts with its record count and
+// byte length, then the pc of its first record as a varint. A record is
+// one byte with the opcode and two flags, followed by what the flags say:
+//   - TRACE_TAKEN:  the next pc is not pc + 4, its distance follows
+//   - TRACE_MEMORY: the address, as a distance from the chunk's last one
+// Distances are zigzag varints. The pc of a record is the next pc of the
+// one before, so most instructions take a single byte. Each chunk decodes
+// on its own, and a chunk without records ends the file.
+#define TRACE_TAKEN  0x40
+#define TRACE_MEMORY 0x80
+#define TRACE_OP     0x3f
+
+// Opcode byte and two 5-byte varints
+#define TRACE_MAX_RECORD_BYTES 11
+#define TRACE_CHUNK_BYTES      (5 + TRACE_CHUNK_RECORDS * TRACE_MAX_RECORD_BYTES)
+
+// One committed instruction
+typedef struct {
+    int pc;
+    int op;
+    int next_pc;
+    int address;            // Data memory word accessed, -1 if none
+} TraceRecord;
+
+typedef struct {
+    FILE *file;
+    unsigned char chunk[TRACE_CHUNK_BYTES];
+    size_t len;             // Bytes of the chunk being filled
+    int records;            // Records of the chunk being filled
+    int next_pc;            // Expected pc of the next record
+    int address;            // Last address of the chunk
+
+    long total_records;
+    long total_bytes;       // Whole file, headers included
+    int chunks;
+} TraceWriter;
+
+// Streams a trace back one chunk at a time. Only the last TRACE_WINDOW
+// decoded records are kept, which covers everything in flight.
+typedef struct {
+    FILE *file;
+    const char *path;
+    unsigned char chunk[TRACE_CHUNK_BYTES];
+    TraceRecord window[TRACE_WINDOW];   // Record i is at i % TRACE_WINDOW
+    long decoded;                       // Records decoded so far
+    bool ended;                         // The last chunk was read
+} TraceReader;
+
+// Creates a trace of `code`, exits if the file can't be written
+void trace_create(TraceWriter *tw, const char *path, const InstructionList *code);
+
+// Appends the instruction the emulator just executed
+void trace_write(TraceWriter *tw, EmuStep step);
+
+// Writes the last chunk and the end of the file
+void trace_finish(TraceWriter *tw);
+
+// Runs `code` on the emulator from data `memory` and records every
+// instruction up to HALT. `memory` is left untouched.
+void trace_record(TraceWriter *tw, const char *path, const InstructionList *code, const int *memory);
+
+void print_trace_stats(const TraceWriter *tw);
+
+// Opens a trace, exits if it was recorded from a program other than `code`
+void trace_open(TraceReader *tr, const char *path, const InstructionList *code);
+
+// Record `index` of the stream, NULL past its end. Records older than the
+// window are gone: `index` must not go back more than TRACE_WINDOW records.
+const TraceRecord *trace_get(TraceReader *tr, long index);
+
+void trace_close(TraceReader *tr);
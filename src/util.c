@@ -5,7 +5,7 @@
 // trim function which removes spaces from the start of the commands 
 void trim_start(char *str) {
     int idx = 0;
-    while (str[idx] == ' ' || str[idx] == '\t' || str[idx] == '\n') {
+    while (str[idx] == ' ' || str[idx] == '\t' || str[idx] == '\n' || str[idx] == '\r') {
         idx += 1;
     }
 
@@ -23,7 +23,10 @@ void trim_start(char *str) {
 void trim_end(char *str)
 {
     int idx = strlen(str) - 1;
-    while (str[idx] == ' ' || str[idx] == '\t' || str[idx] == '\n')
+    if (idx < 0) return;
+
+    // Scripts saved with CRLF line endings end in "\r\n"
+    while (idx >= 0 && (str[idx] == ' ' || str[idx] == '\t' || str[idx] == '\n' || str[idx] == '\r'))
     {
         idx -= 1;
     }